@@ -0,0 +1,128 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <random.h>
+#include <util.h>
+#include <validation.h>
+
+#include <vector>
+
+// Regtest's workComputationChangeTarget is 1430, so most of the chain has
+// the multi-algo proof that startup pays for. Odo is always active on
+// regtest and replaces Groestl at algoSwapChangeTarget.
+static const int CHAIN_LENGTH = 5000;
+
+static const int32_t ALGO_VERSIONS[] = {
+    BLOCK_VERSION_SHA256D,
+    BLOCK_VERSION_SCRYPT,
+    BLOCK_VERSION_GROESTL,
+    BLOCK_VERSION_SKEIN,
+    BLOCK_VERSION_QUBIT,
+};
+
+static const int32_t ALGO_VERSIONS_ODO[] = {
+    BLOCK_VERSION_SHA256D,
+    BLOCK_VERSION_SCRYPT,
+    BLOCK_VERSION_ODO,
+    BLOCK_VERSION_SKEIN,
+    BLOCK_VERSION_QUBIT,
+};
+
+struct MultiAlgoChain
+{
+    std::vector<uint256> hashes;
+    CBlockIndexArena blocks;
+
+    MultiAlgoChain() : hashes(CHAIN_LENGTH)
+    {
+        const Consensus::Params& params = Params().GetConsensus();
+        const uint32_t nBits = UintToArith256(params.powLimit).GetCompact();
+        for (int i = 0; i < CHAIN_LENGTH; i++) {
+            hashes[i] = GetRandHash();
+            CBlockIndex& block = *blocks.Allocate();
+            block.phashBlock = &hashes[i];
+            block.pprev = i ? &blocks[i - 1] : nullptr;
+            block.nHeight = i;
+            block.nVersion = BLOCK_VERSION_DEFAULT | (i < params.algoSwapChangeTarget ? ALGO_VERSIONS : ALGO_VERSIONS_ODO)[i % 5];
+            block.nTime = 1389392876 + i * params.nPowTargetSpacing;
+            block.nBits = nBits;
+            block.BuildSkip();
+        }
+    }
+
+    void ResetChainWork()
+    {
+        for (size_t i = 0; i < blocks.Size(); i++) {
+            blocks[i].nChainWork = arith_uint256();
+            blocks[i].fHaveChainWork = false;
+        }
+    }
+};
+
+// Chain work computation on startup, one proof per entry in height order,
+// as LoadBlockIndex did before CBlockIndexArena::BuildChainWork.
+static void BlockProofChainWork(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    MultiAlgoChain chain;
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        chain.ResetChainWork();
+        for (size_t i = 0; i < chain.blocks.Size(); i++) {
+            chain.blocks[i].BuildChainWork();
+        }
+    }
+}
+
+// The same through CBlockIndexArena::BuildChainWork, as LoadBlockIndex does
+// now, with the block proofs spread over all cores.
+static void BlockProofChainWorkParallel(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    MultiAlgoChain chain;
+    LOCK(cs_main);
+    while (state.KeepRunning()) {
+        chain.ResetChainWork();
+        chain.blocks.BuildChainWork(GetNumCores());
+    }
+}
+
+// Repeated proof lookups of an already indexed tip, as done by
+// GetBlockProofEquivalentTime, with and without the chain work cache.
+static void BlockProofTipCached(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    MultiAlgoChain chain;
+    LOCK(cs_main);
+    for (size_t i = 0; i < chain.blocks.Size(); i++) {
+        chain.blocks[i].BuildChainWork();
+    }
+    const CBlockIndex& tip = chain.blocks[chain.blocks.Size() - 1];
+    while (state.KeepRunning()) {
+        GetBlockProof(tip);
+    }
+}
+
+static void BlockProofTipUncached(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    MultiAlgoChain chain;
+    LOCK(cs_main);
+    for (size_t i = 0; i < chain.blocks.Size(); i++) {
+        chain.blocks[i].BuildChainWork();
+    }
+    CBlockIndex& tip = chain.blocks[chain.blocks.Size() - 1];
+    tip.fHaveChainWork = false;
+    while (state.KeepRunning()) {
+        GetBlockProof(tip);
+    }
+}
+
+BENCHMARK(BlockProofChainWork, 100);
+BENCHMARK(BlockProofChainWorkParallel, 100);
+BENCHMARK(BlockProofTipCached, 40 * 1000 * 1000);
+BENCHMARK(BlockProofTipUncached, 400 * 1000);
@@ -85,3 +85,39 @@ static void CCoinsCaching(benchmark::State& state)
 }
 
 BENCHMARK(CCoinsCaching, 170 * 1000);
+
+// Number of coins created, half spent and then flushed to the parent cache, as
+// a dozen full blocks would.
+static const size_t CHURN_COINS = 50000;
+
+// Coin churn through a two-level CCoinsViewCache, as in ConnectBlock followed
+// by FlushStateToDisk. Stresses the allocation of cache entries and the
+// lookups in cacheCoins.
+static void CCoinsCachingChurn(benchmark::State& state)
+{
+    std::vector<COutPoint> outpoints;
+    outpoints.reserve(CHURN_COINS);
+    for (size_t i = 0; i < CHURN_COINS; i++) {
+        outpoints.emplace_back(uint256S(std::to_string(i / 4)), i % 4);
+    }
+    CTxOut txout(CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG);
+
+    CCoinsView coinsDummy;
+    while (state.KeepRunning()) {
+        CCoinsViewCache base(&coinsDummy);
+        CCoinsViewCache cache(&base);
+        for (const COutPoint& outpoint : outpoints) {
+            cache.AddCoin(outpoint, Coin(txout, 1, false), false);
+        }
+        for (const COutPoint& outpoint : outpoints) {
+            assert(!cache.AccessCoin(outpoint).IsSpent());
+        }
+        for (size_t i = 0; i < outpoints.size(); i += 2) {
+            cache.SpendCoin(outpoints[i]);
+        }
+        bool flushed = cache.Flush();
+        assert(flushed);
+    }
+}
+
+BENCHMARK(CCoinsCachingChurn, 2);
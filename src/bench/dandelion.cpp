@@ -0,0 +1,345 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <net.h>
+#include <net_processing.h>
+#include <random.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdio.h>
+#include <vector>
+
+static CNode* NewFakeNode(NodeId id, bool fInbound)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = htonl(0x0a000001 + id);
+    CAddress addr(CService(ipv4Addr, 12024), NODE_NETWORK);
+    return new CNode(id, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress(), "", fInbound);
+}
+
+/** A CConnman with fake inbound and outbound peers registered for Dandelion routing. */
+struct DandelionRouter
+{
+    CConnman connman;
+    std::vector<std::unique_ptr<CNode>> vInbound;
+    std::vector<std::unique_ptr<CNode>> vOutbound;
+
+    DandelionRouter(int nInbound, int nOutbound) : connman(0x1337, 0x1337)
+    {
+        NodeId id = 0;
+        for (int i = 0; i < nOutbound; i++) {
+            vOutbound.emplace_back(NewFakeNode(id++, false));
+            connman.AddDandelionOutbound(vOutbound.back().get());
+        }
+        for (int i = 0; i < nInbound; i++) {
+            vInbound.emplace_back(NewFakeNode(id++, true));
+            connman.AddDandelionInbound(vInbound.back().get());
+        }
+    }
+};
+
+// Route lookup for each stem transaction received from a full set of inbound peers.
+static void DandelionRoute(benchmark::State& state)
+{
+    DandelionRouter router(DEFAULT_MAX_PEER_CONNECTIONS - 8, 8);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CNode* pto = router.connman.getDandelionDestination(router.vInbound[i++ % router.vInbound.size()].get());
+        assert(pto != nullptr);
+    }
+}
+
+static void DandelionShuffle(benchmark::State& state)
+{
+    DandelionRouter router(DEFAULT_MAX_PEER_CONNECTIONS - 8, 8);
+    while (state.KeepRunning()) {
+        router.connman.DandelionShuffle();
+        router.connman.setLocalDandelionDestination();
+    }
+}
+
+// A thousand embargoes set and then expired in time order.
+static void DandelionEmbargo(benchmark::State& state)
+{
+    CConnman connman(0x1337, 0x1337);
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 1000; i++) {
+        hashes.push_back(GetRandHash());
+    }
+    int64_t nTime = 0;
+    while (state.KeepRunning()) {
+        for (const uint256& hash : hashes) {
+            connman.insertDandelionEmbargo(hash, PoissonNextSend(nTime, DANDELION_EMBARGO_AVG_ADD));
+        }
+        nTime += 3600 * 1000000LL;
+        const std::vector<uint256> vExpired = connman.popExpiredDandelionEmbargoes(nTime);
+        assert(vExpired.size() == hashes.size());
+    }
+}
+
+/** Load put on a simulated Dandelion network. */
+struct DandelionSimParams
+{
+    int nNodes;
+    int nOutbound;
+    int nTransactions;
+    // Simulated time between new transactions, and the latency of each link (microseconds)
+    int64_t nTxInterval;
+    int64_t nLinkLatency;
+};
+
+/**
+ * An in-process Dandelion network without sockets. Every simulated node has
+ * its own CConnman routing state and embargo map, and a fake CNode for each
+ * side of every connection. Stem transactions follow the real routing, stem
+ * inventory queues and embargoes, with simulated time driving the trickle and
+ * embargo timers. A transaction leaves the stem when a node fluffs it or its
+ * embargo ends first; it is then treated as being in every mempool.
+ */
+class DandelionSimulation
+{
+public:
+    explicit DandelionSimulation(const DandelionSimParams& params) : m_params(params)
+    {
+        NodeId id = 0;
+        for (int i = 0; i < params.nNodes; i++) {
+            m_nodes.emplace_back(new CConnman(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())));
+            m_outbound.emplace_back();
+        }
+        for (int i = 0; i < params.nNodes; i++) {
+            std::set<int> setPeers;
+            while ((int)setPeers.size() < std::min(params.nOutbound, params.nNodes - 1)) {
+                const int j = GetRand(params.nNodes);
+                if (j == i || !setPeers.insert(j).second) continue;
+                CNode* pout = NewFakeNode(id++, false);
+                CNode* pin = NewFakeNode(id++, true);
+                m_conns.emplace_back(pout);
+                m_conns.emplace_back(pin);
+                m_links[pout] = Link{j, pin};
+                m_links[pin] = Link{i, pout};
+                m_nodes[i]->AddDandelionOutbound(pout);
+                m_outbound[i].push_back(pout);
+                m_nodes[j]->AddDandelionInbound(pin);
+            }
+        }
+        for (const auto& connman : m_nodes) {
+            connman->DandelionShuffle();
+        }
+    }
+
+    void Run()
+    {
+        m_events.clear();
+        m_txs.clear();
+        m_nEmbargoes = 0;
+        m_nPeakEmbargoes = 0;
+        m_nStemHops = 0;
+        m_nFluffed = 0;
+        m_nEmbargoExpired = 0;
+        m_nDelay = 0;
+        for (const auto& conn : m_conns) {
+            conn->setDandelionInventoryKnown.clear();
+            conn->mapInventoryDandelionTxToSend.clear();
+            conn->nNextDandelionInvSend = 0;
+        }
+        m_setFlushPending.clear();
+
+        for (int i = 0; i < m_params.nTransactions; i++) {
+            m_events.emplace(i * m_params.nTxInterval, Event{Event::CREATE, (int)GetRand(m_params.nNodes), nullptr, GetRandHash()});
+        }
+        m_events.emplace(1000000LL * DANDELION_EMBARGO_CHECK_INTERVAL, Event{Event::EMBARGO_CHECK, 0, nullptr, uint256()});
+
+        while (!m_events.empty()) {
+            const int64_t nTime = m_events.begin()->first;
+            const Event ev = m_events.begin()->second;
+            m_events.erase(m_events.begin());
+            switch (ev.type) {
+            case Event::CREATE: Create(nTime, ev.node, ev.hash); break;
+            case Event::ARRIVE: Arrive(nTime, ev.node, ev.pnode, ev.hash); break;
+            case Event::FLUSH: Flush(nTime, ev.node, ev.pnode); break;
+            case Event::EMBARGO_CHECK: CheckEmbargoes(nTime); break;
+            }
+        }
+        assert(m_nFluffed + m_nEmbargoExpired == (uint64_t)m_params.nTransactions);
+        assert(m_nEmbargoes == 0);
+    }
+
+    void Print(const char* name) const
+    {
+        fprintf(stderr, "%s: %d nodes, %d txs, %.2f stem hops/tx, %.2fs avg stem delay, %.1f%% fluffed by embargo, peak %d embargoes\n",
+            name, m_params.nNodes, m_params.nTransactions,
+            (double)m_nStemHops / m_params.nTransactions,
+            0.000001 * m_nDelay / m_params.nTransactions,
+            100.0 * m_nEmbargoExpired / m_params.nTransactions,
+            m_nPeakEmbargoes);
+    }
+
+private:
+    struct Link {
+        // The node on the other side, and its CNode for this connection
+        int node;
+        CNode* pnode;
+    };
+    struct Event {
+        enum Type { CREATE, ARRIVE, FLUSH, EMBARGO_CHECK } type;
+        int node;
+        CNode* pnode;
+        uint256 hash;
+    };
+    struct TxState {
+        int64_t nCreated;
+        bool fFluffed;
+        std::vector<int> vEmbargoed;
+    };
+
+    const DandelionSimParams m_params;
+    std::vector<std::unique_ptr<CConnman>> m_nodes;
+    std::vector<std::unique_ptr<CNode>> m_conns;
+    std::vector<std::vector<CNode*>> m_outbound;
+    std::map<CNode*, Link> m_links;
+    std::multimap<int64_t, Event> m_events;
+    std::map<uint256, TxState> m_txs;
+    std::set<CNode*> m_setFlushPending;
+    int m_nEmbargoes;
+    int m_nPeakEmbargoes;
+    uint64_t m_nStemHops;
+    uint64_t m_nFluffed;
+    uint64_t m_nEmbargoExpired;
+    int64_t m_nDelay;
+    FastRandomContext m_rng;
+
+    void Embargo(int64_t nTime, int node, const uint256& hash)
+    {
+        const int64_t nEmbargo = 1000000LL * DANDELION_EMBARGO_MINIMUM + PoissonNextSend(nTime, DANDELION_EMBARGO_AVG_ADD);
+        if (m_nodes[node]->insertDandelionEmbargo(hash, nEmbargo)) {
+            m_txs[hash].vEmbargoed.push_back(node);
+            m_nPeakEmbargoes = std::max(m_nPeakEmbargoes, ++m_nEmbargoes);
+        }
+    }
+
+    /** Schedule the stem inventory just pushed to pto to be sent with its next batch. */
+    void Queue(int64_t nTime, int node, CNode* pto, const uint256& hash)
+    {
+        // Queue times are in simulated time
+        auto it = pto->mapInventoryDandelionTxToSend.find(hash);
+        if (it != pto->mapInventoryDandelionTxToSend.end()) {
+            it->second = nTime;
+        }
+        if (m_setFlushPending.insert(pto).second) {
+            m_events.emplace(std::max(nTime, pto->nNextDandelionInvSend), Event{Event::FLUSH, node, pto, uint256()});
+        }
+    }
+
+    void Fluff(int64_t nTime, const uint256& hash)
+    {
+        TxState& tx = m_txs[hash];
+        tx.fFluffed = true;
+        m_nDelay += nTime - tx.nCreated;
+        // Once in the mempool every node drops its embargo
+        for (int node : tx.vEmbargoed) {
+            if (m_nodes[node]->removeDandelionEmbargo(hash)) {
+                m_nEmbargoes--;
+            }
+        }
+    }
+
+    void Create(int64_t nTime, int node, const uint256& hash)
+    {
+        m_txs[hash] = TxState{nTime, false, {}};
+        Embargo(nTime, node, hash);
+        if (m_nodes[node]->localDandelionDestinationPushInventory(CInv(MSG_DANDELION_TX, hash))) {
+            for (CNode* pto : m_outbound[node]) {
+                if (pto->mapInventoryDandelionTxToSend.count(hash)) {
+                    Queue(nTime, node, pto, hash);
+                }
+            }
+        }
+    }
+
+    void Arrive(int64_t nTime, int node, CNode* pfrom, const uint256& hash)
+    {
+        if (m_txs[hash].fFluffed) return;
+        pfrom->setDandelionInventoryKnown.insert(hash);
+        m_nStemHops++;
+        CConnman& connman = *m_nodes[node];
+        Embargo(nTime, node, hash);
+        if (m_rng.randrange(100) < DANDELION_FLUFF) {
+            connman.RecordDandelionFluff();
+            m_nFluffed++;
+            Fluff(nTime, hash);
+            return;
+        }
+        CNode* pto = connman.getDandelionDestination(pfrom);
+        if (pto != nullptr) {
+            pto->PushInventory(CInv(MSG_DANDELION_TX, hash));
+            Queue(nTime, node, pto, hash);
+        }
+    }
+
+    void Flush(int64_t nTime, int node, CNode* pto)
+    {
+        m_setFlushPending.erase(pto);
+        pto->nNextDandelionInvSend = PoissonNextSend(nTime, DANDELION_INVENTORY_BROADCAST_INTERVAL);
+        const Link& link = m_links.at(pto);
+        uint64_t nStemRelayed = 0;
+        int64_t nStemLatency = 0;
+        for (const auto& entry : pto->mapInventoryDandelionTxToSend) {
+            pto->setDandelionInventoryKnown.insert(entry.first);
+            nStemRelayed++;
+            nStemLatency += nTime - entry.second;
+            m_events.emplace(nTime + m_params.nLinkLatency, Event{Event::ARRIVE, link.node, link.pnode, entry.first});
+        }
+        pto->mapInventoryDandelionTxToSend.clear();
+        pto->nDandelionStemSent += nStemRelayed;
+        m_nodes[node]->RecordDandelionStemRelay(nStemRelayed, nStemLatency);
+    }
+
+    void CheckEmbargoes(int64_t nTime)
+    {
+        for (const auto& connman : m_nodes) {
+            for (const uint256& hash : connman->popExpiredDandelionEmbargoes(nTime)) {
+                m_nEmbargoes--;
+                if (!m_txs[hash].fFluffed) {
+                    connman->RecordDandelionEmbargoExpiry();
+                    m_nEmbargoExpired++;
+                    Fluff(nTime, hash);
+                }
+            }
+        }
+        if (m_nEmbargoes > 0 || m_nFluffed + m_nEmbargoExpired < (uint64_t)m_params.nTransactions) {
+            m_events.emplace(nTime + 1000000LL * DANDELION_EMBARGO_CHECK_INTERVAL, Event{Event::EMBARGO_CHECK, 0, nullptr, uint256()});
+        }
+    }
+};
+
+static void DandelionSimulate(benchmark::State& state, const char* name, const DandelionSimParams& params)
+{
+    DandelionSimulation sim(params);
+    while (state.KeepRunning()) {
+        sim.Run();
+    }
+    sim.Print(name);
+}
+
+// One transaction a second, and a burst of a hundred a second.
+static void DandelionSimulationLowLoad(benchmark::State& state)
+{
+    DandelionSimulate(state, "DandelionSimulationLowLoad", DandelionSimParams{32, 8, 200, 1000000, 50000});
+}
+
+static void DandelionSimulationHighLoad(benchmark::State& state)
+{
+    DandelionSimulate(state, "DandelionSimulationHighLoad", DandelionSimParams{32, 8, 2000, 10000, 50000});
+}
+
+BENCHMARK(DandelionRoute, 1000 * 1000);
+BENCHMARK(DandelionShuffle, 1000);
+BENCHMARK(DandelionEmbargo, 1000);
+BENCHMARK(DandelionSimulationLowLoad, 10);
+BENCHMARK(DandelionSimulationHighLoad, 10);
@@ -0,0 +1,106 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chain.h>
+#include <chainparams.h>
+#include <consensus/validation.h>
+#include <pow.h>
+#include <random.h>
+#include <syncstats.h>
+#include <txdb.h>
+#include <validation.h>
+#include <versionbits.h>
+
+#include <algorithm>
+#include <vector>
+
+// Two HEADERS messages worth of headers, nearly all past regtest's
+// workComputationChangeTarget and algoSwapChangeTarget, so that they run the
+// V4 retarget and the Odo deployment check.
+static const size_t HEADER_COUNT = 2 * MAX_HEADERS_RESULTS;
+
+static void ResetBlockIndex()
+{
+    UnloadBlockIndex();
+    bool loaded = LoadGenesisBlock(Params());
+    assert(loaded);
+}
+
+/** Mine a chain of headers on top of genesis, adding them to the block index on the way. */
+static std::vector<CBlockHeader> MineHeaders(size_t count)
+{
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<CBlockHeader> headers;
+    const CBlockIndex* pindexPrev;
+    {
+        LOCK(cs_main);
+        pindexPrev = LookupBlockIndex(params.hashGenesisBlock);
+    }
+    for (size_t i = 0; i < count; i++) {
+        // Take turns between the algos active on top of pindexPrev
+        int algo = ALGO_SCRYPT;
+        {
+            LOCK(cs_main);
+            for (int n = 0; n < NUM_ALGOS_IMPL; n++) {
+                if (IsAlgoActive(pindexPrev, params, (i + n) % NUM_ALGOS_IMPL)) {
+                    algo = (i + n) % NUM_ALGOS_IMPL;
+                    break;
+                }
+            }
+        }
+        CBlockHeader header;
+        header.nVersion = VERSIONBITS_TOP_BITS | GetVersionForAlgo(algo);
+        header.hashPrevBlock = pindexPrev->GetBlockHash();
+        header.hashMerkleRoot = GetRandHash();
+        // Slower than the target, so that the difficulty stays at the limit
+        header.nTime = pindexPrev->nTime + 4 * NUM_ALGOS * params.nTargetSpacing;
+        header.nBits = GetNextWorkRequired(pindexPrev, &header, params, algo);
+        while (!CheckProofOfWork(GetPoWAlgoHash(header), header.nBits, params)) {
+            ++header.nNonce;
+        }
+        CValidationState state;
+        bool accepted = ProcessNewBlockHeaders({header}, state, Params(), &pindexPrev);
+        assert(accepted);
+        headers.push_back(header);
+    }
+    return headers;
+}
+
+// Replay of a synthetic chain through ProcessNewBlockHeaders, in HEADERS
+// message sized batches, starting from an index holding only genesis.
+static void HeaderSyncReplay(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+    std::vector<CBlockHeader> headers;
+    {
+        LOCK(cs_main);
+        ResetBlockIndex();
+    }
+    headers = MineHeaders(HEADER_COUNT);
+    g_sync_stats.Reset();
+
+    while (state.KeepRunning()) {
+        {
+            LOCK(cs_main);
+            ResetBlockIndex();
+        }
+        for (size_t i = 0; i < headers.size(); i += MAX_HEADERS_RESULTS) {
+            const std::vector<CBlockHeader> batch(headers.begin() + i, headers.begin() + std::min<size_t>(i + MAX_HEADERS_RESULTS, headers.size()));
+            CValidationState validation_state;
+            bool accepted = ProcessNewBlockHeaders(batch, validation_state, Params());
+            assert(accepted);
+        }
+    }
+
+    {
+        LOCK(cs_main);
+        UnloadBlockIndex();
+    }
+    pblocktree.reset();
+    g_sync_stats.Reset();
+}
+
+BENCHMARK(HeaderSyncReplay, 2);
@@ -0,0 +1,199 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <crypto/hashgroestl.h>
+#include <crypto/hashodo.h>
+#include <crypto/hashqubit.h>
+#include <crypto/scrypt.h>
+#include <primitives/block.h>
+#include <random.h>
+
+#include <vector>
+
+/* Number of 80 byte headers to hash per iteration */
+static const size_t HEADER_COUNT = 64;
+
+static std::vector<char> RandomHeaders(size_t count)
+{
+    FastRandomContext rng(true);
+    std::vector<char> headers(80 * count);
+    for (char& c : headers)
+        c = rng.randbits(8);
+    return headers;
+}
+
+static void Scrypt_64Headers(benchmark::State& state)
+{
+    std::vector<char> headers = RandomHeaders(HEADER_COUNT);
+    std::vector<char> hashes(32 * HEADER_COUNT);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < HEADER_COUNT; i++)
+            scrypt_1024_1_1_256(&headers[80 * i], &hashes[32 * i]);
+    }
+}
+
+static void ScryptMulti_64Headers(benchmark::State& state)
+{
+    std::vector<char> headers = RandomHeaders(HEADER_COUNT);
+    std::vector<char> hashes(32 * HEADER_COUNT);
+    while (state.KeepRunning()) {
+        scrypt_1024_1_1_256_multi(headers.data(), hashes.data(), HEADER_COUNT);
+    }
+}
+
+// Odo key of a mainnet header; the key only changes once per shapechange interval.
+static const uint32_t ODO_KEY = 1570060800;
+
+static void OdoHash(benchmark::State& state)
+{
+    std::vector<char> header = RandomHeaders(1);
+    while (state.KeepRunning()) {
+        HashOdo(header.begin(), header.end(), ODO_KEY);
+    }
+}
+
+static void OdoHashUncached(benchmark::State& state)
+{
+    std::vector<char> header = RandomHeaders(1);
+    while (state.KeepRunning()) {
+        HashOdo(header.begin(), header.end(), OdoCrypt(ODO_KEY));
+    }
+}
+
+static void QubitHash(benchmark::State& state)
+{
+    std::vector<char> header = RandomHeaders(1);
+    while (state.KeepRunning()) {
+        HashQubit(header.begin(), header.end());
+    }
+}
+
+// The stages that QubitAutoDetect may replace, on an 80 byte header or a 64 byte input.
+static void GroestlHeader(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        Groestl512Header((const unsigned char*)in.data(), out);
+    }
+}
+
+static void QubitLuffa(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        QubitLuffa512((const unsigned char*)in.data(), out);
+    }
+}
+
+static void QubitCubehash(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        QubitCubehash512((const unsigned char*)in.data(), out);
+    }
+}
+
+static void QubitShavite(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        QubitShavite512((const unsigned char*)in.data(), out);
+    }
+}
+
+static void QubitSimd(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        QubitSimd512((const unsigned char*)in.data(), out);
+    }
+}
+
+static void QubitEcho(benchmark::State& state)
+{
+    std::vector<char> in = RandomHeaders(1);
+    unsigned char out[64];
+    while (state.KeepRunning()) {
+        QubitEcho512((const unsigned char*)in.data(), out);
+    }
+}
+
+// Header hashing through CBlockHeader::GetPoWAlgoHash, the cost paid per header
+// during header sync. Every iteration hashes one header, so the reported times
+// are per header (headers per second = 1 / time).
+
+// A mainnet time after the Odo activation
+static const uint32_t HEADER_TIME = 1571000000;
+
+static std::vector<CBlockHeader> RandomAlgoHeaders(const std::vector<int32_t>& algoVersions)
+{
+    FastRandomContext rng(true);
+    std::vector<CBlockHeader> headers(algoVersions.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        headers[i].nVersion = BLOCK_VERSION_DEFAULT | algoVersions[i];
+        headers[i].hashPrevBlock = rng.rand256();
+        headers[i].hashMerkleRoot = rng.rand256();
+        headers[i].nTime = HEADER_TIME + 15 * i;
+        headers[i].nBits = 0x1b01b1fb;
+        headers[i].nNonce = rng.rand32();
+    }
+    return headers;
+}
+
+static void PoWAlgoHash(benchmark::State& state, const std::vector<int32_t>& algoVersions)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const std::vector<CBlockHeader> headers = RandomAlgoHeaders(algoVersions);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        headers[i].GetPoWAlgoHash(chainParams->GetConsensus());
+        if (++i == headers.size())
+            i = 0;
+    }
+}
+
+static void PoWHash_SHA256D(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_SHA256D)); }
+static void PoWHash_Scrypt(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_SCRYPT)); }
+static void PoWHash_Groestl(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_GROESTL)); }
+static void PoWHash_Skein(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_SKEIN)); }
+static void PoWHash_Qubit(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_QUBIT)); }
+static void PoWHash_Odo(benchmark::State& state) { PoWAlgoHash(state, std::vector<int32_t>(100, BLOCK_VERSION_ODO)); }
+
+// Since the Odo activation mainnet targets an equal share of blocks for each of
+// the five active algos, interleaved in no particular order.
+static void PoWHash_MainnetMix(benchmark::State& state)
+{
+    const int32_t activeAlgos[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT, BLOCK_VERSION_ODO};
+    FastRandomContext rng(true);
+    std::vector<int32_t> algoVersions;
+    for (int i = 0; i < 100; i++)
+        algoVersions.push_back(activeAlgos[rng.randrange(5)]);
+    PoWAlgoHash(state, algoVersions);
+}
+
+BENCHMARK(Scrypt_64Headers, 60);
+BENCHMARK(ScryptMulti_64Headers, 200);
+BENCHMARK(OdoHash, 30 * 1000);
+BENCHMARK(OdoHashUncached, 15 * 1000);
+BENCHMARK(QubitHash, 80 * 1000);
+BENCHMARK(GroestlHeader, 500 * 1000);
+BENCHMARK(QubitLuffa, 500 * 1000);
+BENCHMARK(QubitCubehash, 300 * 1000);
+BENCHMARK(QubitShavite, 1000 * 1000);
+BENCHMARK(QubitSimd, 300 * 1000);
+BENCHMARK(QubitEcho, 1000 * 1000);
+BENCHMARK(PoWHash_SHA256D, 3 * 1000 * 1000);
+BENCHMARK(PoWHash_Scrypt, 4 * 1000);
+BENCHMARK(PoWHash_Groestl, 400 * 1000);
+BENCHMARK(PoWHash_Skein, 1000 * 1000);
+BENCHMARK(PoWHash_Qubit, 150 * 1000);
+BENCHMARK(PoWHash_Odo, 30 * 1000);
+BENCHMARK(PoWHash_MainnetMix, 20 * 1000);
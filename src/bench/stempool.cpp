@@ -0,0 +1,75 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <policy/policy.h>
+#include <txmempool.h>
+
+#include <vector>
+
+static void AddTx(const CTransactionRef& tx, CTxMemPool& pool) EXCLUSIVE_LOCKS_REQUIRED(pool.cs)
+{
+    LockPoints lp;
+    pool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 1000LL, 0, 1, false, 4, lp));
+}
+
+/** Chains of ten transactions, as relayed into the mempool one after another. */
+static std::vector<CTransactionRef> RelayedTransactions()
+{
+    std::vector<CTransactionRef> txs;
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        if (i % 10 == 0) {
+            tx.vin[0].prevout.SetNull();
+            tx.vin[0].scriptSig = CScript() << i;
+        } else {
+            tx.vin[0].prevout = COutPoint(txs.back()->GetHash(), 0);
+        }
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = COIN;
+        txs.push_back(MakeTransactionRef(tx));
+    }
+    return txs;
+}
+
+// Every 20th transaction passes through the Dandelion stem phase before
+// reaching the mempool. The stem pool either mirrors the whole mempool or is
+// an overlay on top of it that only holds the stem transactions.
+static void StemPool(benchmark::State& state, bool fOverlay)
+{
+    const std::vector<CTransactionRef> txs = RelayedTransactions();
+
+    while (state.KeepRunning()) {
+        CTxMemPool pool;
+        CTxMemPool stempool(nullptr, fOverlay ? &pool : nullptr);
+        LOCK2(pool.cs, stempool.cs);
+        for (size_t i = 0; i < txs.size(); i++) {
+            const bool fStem = i % 20 == 0;
+            if (fStem) {
+                AddTx(txs[i], stempool);
+            }
+            AddTx(txs[i], pool);
+            if (fOverlay) {
+                stempool.removeForBase(*txs[i]);
+            } else if (!fStem) {
+                AddTx(txs[i], stempool);
+            }
+        }
+    }
+}
+
+static void StemPoolMirror(benchmark::State& state)
+{
+    StemPool(state, false);
+}
+
+static void StemPoolOverlay(benchmark::State& state)
+{
+    StemPool(state, true);
+}
+
+BENCHMARK(StemPoolMirror, 100);
+BENCHMARK(StemPoolOverlay, 100);
@@ -15,15 +15,24 @@
 
 #include <unordered_map>
 
-CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID, const CTxMemPool* pool) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
-        shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
+        prefilledtxn(1), header(block) {
     FillShortTxIDSelector();
-    //TODO: Use our mempool prior to block acceptance to predictively fill more than just the coinbase
     prefilledtxn[0] = {0, block.vtx[0]};
+    shorttxids.reserve(block.vtx.size() - 1);
+    size_t nPrefillBytes = 0;
+    size_t nLastPrefilled = 0;
     for (size_t i = 1; i < block.vtx.size(); i++) {
         const CTransaction& tx = *block.vtx[i];
-        shorttxids[i - 1] = GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash());
+        // Transactions that did not make it to our mempool are likely missing from our peers' as well
+        if (pool && i <= std::numeric_limits<uint16_t>::max() && nPrefillBytes + tx.GetTotalSize() <= MAX_CMPCTBLOCK_PREFILL_BYTES && !pool->exists(tx.GetHash())) {
+            nPrefillBytes += tx.GetTotalSize();
+            prefilledtxn.push_back({static_cast<uint16_t>(i - nLastPrefilled - 1), block.vtx[i]});
+            nLastPrefilled = i;
+            continue;
+        }
+        shorttxids.push_back(GetShortID(fUseWTXID ? tx.GetWitnessHash() : tx.GetHash()));
     }
 }
 
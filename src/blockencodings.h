@@ -11,6 +11,10 @@
 
 class CTxMemPool;
 
+/** Most bytes of transactions, besides the coinbase, that we prefill in a compact block because our
+ *  mempool lacked them. Each avoids a GETBLOCKTXN round trip for peers that lack them too. */
+static const unsigned int MAX_CMPCTBLOCK_PREFILL_BYTES = 10000;
+
 // Dumb helper to handle CTransaction compression at serialize-time
 struct TransactionCompressor {
 private:
@@ -148,7 +152,9 @@ public:
     // Dummy for deserialization
     CBlockHeaderAndShortTxIDs() {}
 
-    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID);
+    /** Prefills the coinbase and, if pool is given, the transactions it does not have, up to
+     *  MAX_CMPCTBLOCK_PREFILL_BYTES of them. Only meaningful before the block is connected. */
+    CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID, const CTxMemPool* pool = nullptr);
 
     uint64_t GetShortID(const uint256& txhash) const;
 
@@ -5,8 +5,13 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <memusage.h>
 #include <validation.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 /**
  * CChain implementation
  */
@@ -118,6 +123,29 @@ void CBlockIndex::BuildSkip()
 {
     if (pprev)
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
+
+    // Only link entries whose ancestors are linked, so that GetLastBlockIndexForAlgo
+    // can fall back to walking pprev on partially built chains.
+    const int slot = GetAlgoSlot(GetAlgo());
+    if (slot < 0 || (pprev && !pprev->HasAlgoLinks()))
+        return;
+    for (int i = 0; i < NUM_ALGO_SLOTS; i++)
+        lastAlgoHeights[i] = pprev ? pprev->lastAlgoHeights[i] : -1;
+    lastAlgoHeights[slot] = nHeight;
+}
+
+const CBlockIndex* CBlockIndex::GetLastAlgoBlock(int algo) const
+{
+    const int slot = GetAlgoSlot(algo);
+    if (slot < 0 || lastAlgoHeights[slot] < 0)
+        return nullptr;
+    return GetAncestor(lastAlgoHeights[slot]);
+}
+
+void CBlockIndex::BuildChainWork()
+{
+    nChainWork = (pprev ? pprev->nChainWork : 0) + GetBlockProof(*this);
+    fHaveChainWork = true;
 }
 
 int GetAlgoWorkFactor(int nHeight, int algo) 
@@ -162,6 +190,17 @@ arith_uint256 GetBlockProofBase(const CBlockIndex& block)
 
 // DGB 6.14.1 GetBlock Proof
 arith_uint256 GetBlockProof(const CBlockIndex& block)
+{
+    // Since workComputationChangeTarget the proof runs a full retarget for every
+    // active algo, so reuse the result already folded into nChainWork if we have it.
+    if (block.fHaveChainWork)
+        return block.nChainWork - (block.pprev ? block.pprev->nChainWork : arith_uint256());
+
+    const Consensus::Params& params = Params().GetConsensus();
+    return GetBlockProof(block, block.nHeight >= params.workComputationChangeTarget && IsOdoActive(block.pprev, params));
+}
+
+arith_uint256 GetBlockProof(const CBlockIndex& block, bool fOdoActive)
 {
     CBlockHeader header = block.GetBlockHeader();
     int nHeight = block.nHeight;
@@ -180,7 +219,7 @@ arith_uint256 GetBlockProof(const CBlockIndex& block)
 
         for (int i = 0; i < NUM_ALGOS_IMPL; i++)
         {
-            if (!IsAlgoActive(block.pprev, params, i))
+            if (!IsAlgoActive(block.pprev, params, i, fOdoActive))
                 continue;
             unsigned int nBits = GetNextWorkRequired(block.pprev, &header, params, i);
             arith_uint256 bnTarget;
@@ -220,6 +259,126 @@ int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& fr
     return sign * r.GetLow64();
 }
 
+CBlockIndex* CBlockIndexArena::Allocate()
+{
+    if (m_size == m_chunks.size() * CHUNK_SIZE) {
+        m_chunks.emplace_back(new CBlockIndex[CHUNK_SIZE]);
+        m_chunk_pos.emplace(m_chunks.back().get(), m_chunks.size() - 1);
+    }
+    return &(*this)[m_size++];
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(const CBlockHeader& block)
+{
+    CBlockIndex* pindex = Allocate();
+    *pindex = CBlockIndex(block);
+    return pindex;
+}
+
+void CBlockIndexArena::Clear()
+{
+    m_chunks.clear();
+    m_chunk_pos.clear();
+    m_size = 0;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return memusage::MallocUsage(sizeof(CBlockIndex) * CHUNK_SIZE) * m_chunks.size() + memusage::DynamicUsage(m_chunks) + memusage::DynamicUsage(m_chunk_pos);
+}
+
+void CBlockIndexArena::BuildChainWork(int nThreads)
+{
+    // Hand out entries in runs, so threads rarely contend on the counter and
+    // mostly walk ancestors another thread has not just been writing to.
+    static const size_t BATCH_SIZE = 1024;
+
+    // The version bits cache is filled as it is read, so only touch it here
+    const Consensus::Params& params = Params().GetConsensus();
+    std::vector<bool> vOdoActive(m_size);
+    for (size_t pos = 0; pos < m_size; pos++) {
+        const CBlockIndex& entry = (*this)[pos];
+        vOdoActive[pos] = !entry.fHaveChainWork && entry.nHeight >= params.workComputationChangeTarget && IsOdoActive(entry.pprev, params);
+    }
+
+    // Leave each proof in nChainWork for now; the flag stays unset so that
+    // GetBlockProof does not take it for a chain work difference.
+    std::atomic<size_t> next(0);
+    auto worker = [this, &next, &vOdoActive]() {
+        for (size_t begin = next.fetch_add(BATCH_SIZE); begin < m_size; begin = next.fetch_add(BATCH_SIZE)) {
+            for (size_t pos = begin; pos < std::min(begin + BATCH_SIZE, m_size); pos++) {
+                CBlockIndex& entry = (*this)[pos];
+                if (!entry.fHaveChainWork)
+                    entry.nChainWork = GetBlockProof(entry, vOdoActive[pos]);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads && (size_t)i * BATCH_SIZE < m_size; i++)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (size_t pos = 0; pos < m_size; pos++) {
+        CBlockIndex& entry = (*this)[pos];
+        if (entry.fHaveChainWork)
+            continue;
+        if (entry.pprev)
+            entry.nChainWork += entry.pprev->nChainWork;
+        entry.fHaveChainWork = true;
+    }
+}
+
+size_t CBlockIndexArena::PosOf(const CBlockIndex* pindex) const
+{
+    auto it = m_chunk_pos.upper_bound(pindex);
+    assert(it != m_chunk_pos.begin());
+    --it;
+    return it->second * CHUNK_SIZE + (pindex - it->first);
+}
+
+void CBlockIndexArena::SortByHeight(const std::function<void(const Relocation&)>& relink)
+{
+    // Counting sort: the new position of every entry, stable within a height
+    std::vector<uint32_t> vPos(m_size);
+    {
+        int nMaxHeight = 0;
+        for (size_t i = 0; i < m_size; i++) {
+            nMaxHeight = std::max(nMaxHeight, (*this)[i].nHeight);
+        }
+        std::vector<uint32_t> vStart(nMaxHeight + 2, 0);
+        for (size_t i = 0; i < m_size; i++) {
+            vStart[(*this)[i].nHeight + 1]++;
+        }
+        for (int h = 0; h <= nMaxHeight; h++) {
+            vStart[h + 1] += vStart[h];
+        }
+        for (size_t i = 0; i < m_size; i++) {
+            vPos[i] = vStart[(*this)[i].nHeight]++;
+        }
+    }
+
+    const Relocation relocate = [this, &vPos](CBlockIndex* pindex) -> CBlockIndex* {
+        return pindex ? &(*this)[vPos[PosOf(pindex)]] : nullptr;
+    };
+    for (size_t i = 0; i < m_size; i++) {
+        CBlockIndex& entry = (*this)[i];
+        entry.pprev = relocate(entry.pprev);
+        entry.pskip = relocate(entry.pskip);
+    }
+    relink(relocate);
+
+    // Apply the permutation one cycle at a time
+    for (size_t i = 0; i < m_size; i++) {
+        while (vPos[i] != i) {
+            const size_t j = vPos[i];
+            std::swap((*this)[i], (*this)[j]);
+            std::swap(vPos[i], vPos[j]);
+        }
+    }
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-nullptr. */
 const CBlockIndex* LastCommonAncestor(const CBlockIndex* pa, const CBlockIndex* pb) {
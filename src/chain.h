@@ -13,6 +13,9 @@
 #include <tinyformat.h>
 #include <uint256.h>
 
+#include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 
 /**
@@ -161,8 +164,21 @@ enum BlockStatus: uint32_t {
     BLOCK_FAILED_MASK        =   BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 
     BLOCK_OPT_WITNESS       =   128, //!< block data in blk*.data was received with a witness-enforcing client
+
+    BLOCK_POW_CHECKED       =   256, //!< header proof of work was verified when the entry was created
 };
 
+//! Number of entries in CBlockIndex::lastAlgoHeights, one per implemented algo
+static const int NUM_ALGO_SLOTS = 6;
+
+//! Entry of an algo in CBlockIndex::lastAlgoHeights, or -1 for ids that no algo uses.
+inline int GetAlgoSlot(int algo)
+{
+    if (algo >= ALGO_SHA256D && algo <= ALGO_QUBIT)
+        return algo;
+    return algo == ALGO_ODO ? ALGO_QUBIT + 1 : -1;
+}
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -180,6 +196,11 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
+    //! heights of the most recent block of each algo, up to and including this block, by GetAlgoSlot.
+    //! -1 if there is none. Heights rather than pointers keep the links at 4 bytes and independent of
+    //! where the entries are stored; GetAncestor resolves them through the skip list.
+    int32_t lastAlgoHeights[NUM_ALGO_SLOTS];
+
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
@@ -220,11 +241,17 @@ public:
     //! (memory only) Maximum nTime in the chain up to and including this block.
     unsigned int nTimeMax;
 
+    //! (memory only) Whether nChainWork was set by BuildChainWork, so that this block's
+    //! proof can be recovered from nChainWork - pprev->nChainWork instead of recomputed.
+    bool fHaveChainWork;
+
     void SetNull()
     {
         phashBlock = nullptr;
         pprev = nullptr;
         pskip = nullptr;
+        for (int i = 0; i < NUM_ALGO_SLOTS; i++)
+            lastAlgoHeights[i] = -1;
         nHeight = 0;
         nFile = 0;
         nDataPos = 0;
@@ -235,6 +262,7 @@ public:
         nStatus = 0;
         nSequenceId = 0;
         nTimeMax = 0;
+        fHaveChainWork = false;
 
         nVersion       = 0;
         hashMerkleRoot = uint256();
@@ -303,10 +331,20 @@ public:
 
     int GetAlgo() const
     {
-        CBlockHeader block = GetBlockHeader();
+        CBlockHeader block;
+        block.nVersion = nVersion;
         return block.GetAlgo();
     }
-    
+
+    //! Whether BuildSkip has linked this entry to the most recent block of each algo.
+    bool HasAlgoLinks() const
+    {
+        const int slot = GetAlgoSlot(GetAlgo());
+        return slot >= 0 && lastAlgoHeights[slot] == nHeight;
+    }
+
+    //! The most recent block of algo up to and including this one. Requires HasAlgoLinks().
+    const CBlockIndex* GetLastAlgoBlock(int algo) const;
 
     int64_t GetBlockTime() const
     {
@@ -366,15 +404,20 @@ public:
     }
 
 
-    //! Build the skiplist pointer for this entry.
+    //! Build the skiplist pointer and the per-algo links for this entry.
     void BuildSkip();
 
+    //! Set nChainWork from pprev->nChainWork and this block's proof. Requires pprev's chain work.
+    void BuildChainWork();
+
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
     const CBlockIndex* GetAncestor(int height) const;
 };
 
 arith_uint256 GetBlockProof(const CBlockIndex& block);
+/** GetBlockProof with the Odo deployment state for block.pprev already looked up, for computing proofs off the version bits cache. */
+arith_uint256 GetBlockProof(const CBlockIndex& block, bool fOdoActive);
 
 /** Return the time it would take to redo the work difference between from and to, assuming the current hashrate corresponds to the difficulty at tip, in seconds. */
 int64_t GetBlockProofEquivalentTime(const CBlockIndex& to, const CBlockIndex& from, const CBlockIndex& tip, const Consensus::Params&);
@@ -447,6 +490,60 @@ public:
     }
 };
 
+/**
+ * Storage for the block index entries, which live until the whole index is
+ * unloaded. Entries are handed out from large contiguous chunks instead of
+ * one heap allocation each, and can be laid out in order of height so that
+ * walking back a chain touches neighbouring memory. Saving the malloc
+ * overhead of each entry makes up for most of the 24 bytes that
+ * lastAlgoHeights adds to it.
+ */
+class CBlockIndexArena
+{
+public:
+    /** Maps the address of an entry before SortByHeight to its new address. */
+    typedef std::function<CBlockIndex*(CBlockIndex*)> Relocation;
+
+    /** Return a new entry. Entries only move in SortByHeight. */
+    CBlockIndex* Allocate();
+    CBlockIndex* Allocate(const CBlockHeader& block);
+
+    size_t Size() const { return m_size; }
+    CBlockIndex& operator[](size_t pos) { return m_chunks[pos / CHUNK_SIZE][pos % CHUNK_SIZE]; }
+
+    /** Free all entries at once. */
+    void Clear();
+
+    size_t DynamicMemoryUsage() const;
+
+    /**
+     * Reorder the entries by height. The pointers between entries are
+     * updated; relink is called to update any other pointers into the arena
+     * before the entries are moved.
+     */
+    void SortByHeight(const std::function<void(const Relocation&)>& relink);
+
+    /**
+     * Set nChainWork on every entry that does not have it yet. The entries
+     * must be in height order with pskip and lastAlgoHeights linked. Block
+     * proofs only read the headers of ancestors, so they are computed on
+     * nThreads threads and only the running sum is done serially. The Odo
+     * deployment state, which comes from the version bits cache, is looked
+     * up serially beforehand and handed to the threads.
+     */
+    void BuildChainWork(int nThreads);
+
+private:
+    static const size_t CHUNK_SIZE = 4096;
+
+    std::vector<std::unique_ptr<CBlockIndex[]>> m_chunks;
+    // Position in m_chunks of each chunk, by address
+    std::map<const CBlockIndex*, size_t> m_chunk_pos;
+    size_t m_size = 0;
+
+    size_t PosOf(const CBlockIndex* pindex) const;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
@@ -31,7 +31,8 @@ size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), m_cache_coins_memory_resource(new CCoinsMapMemoryResource()),
+    cacheCoins(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), m_cache_coins_memory_resource.get()), cachedCoinsUsage(0) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
     return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
@@ -132,6 +133,14 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+void CCoinsViewCache::AddFetchedCoin(const COutPoint &outpoint, Coin&& coin) {
+    assert(!coin.IsSpent());
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (ret.second) {
+        cachedCoinsUsage += ret.first->second.coin.DynamicMemoryUsage();
+    }
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -203,10 +212,76 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    ReallocateCache();
     cachedCoinsUsage = 0;
     return fOk;
 }
 
+CCoinsMap CCoinsViewCache::TakeDirtyEntries(size_t nMaxUsage) {
+    // A kept entry takes a node in the pool and up to two bucket pointers, as
+    // the bucket count is rounded up from the number of entries
+    auto usage = [](const CCoinsCacheEntry& entry) { return memusage::MallocUsage(sizeof(CoinsCachePair) + 2 * sizeof(void*)) + 2 * sizeof(void*) + entry.coin.DynamicMemoryUsage(); };
+    // The entries taken out come first, then the last, partly used chunk of
+    // the fresh memory resource the kept entries go to
+    size_t nTotalUsage = memusage::MallocUsage(m_cache_coins_memory_resource->ChunkSizeBytes()) + memusage::MallocUsage(sizeof(void*) * 3);
+    for (const auto& entry : cacheCoins) {
+        if (entry.second.flags & CCoinsCacheEntry::DIRTY)
+            nTotalUsage += usage(entry.second);
+    }
+
+    // Count the unspent entries that fit in the rest, FRESH ones first. Erasing
+    // others does not change the order of the map, so the first ones of each
+    // kind in it are kept.
+    size_t nKeep[2] = {0, 0};
+    for (int pass = 0; pass < 2; pass++) {
+        for (const auto& entry : cacheCoins) {
+            if (entry.second.coin.IsSpent() || ((entry.second.flags & CCoinsCacheEntry::FRESH) != 0) != (pass == 0))
+                continue;
+            const size_t nEntryUsage = usage(entry.second);
+            if (nTotalUsage + nEntryUsage > nMaxUsage)
+                break;
+            nTotalUsage += nEntryUsage;
+            nKeep[pass]++;
+        }
+    }
+
+    // The memory resource keeps every chunk it ever allocated, so move the kept
+    // entries to a fresh one and free the old one with the rest of the cache.
+    // Each entry is erased as soon as it is moved, so only the kept entries are
+    // held twice for a while.
+    std::unique_ptr<CCoinsMapMemoryResource> resource(new CCoinsMapMemoryResource());
+    CCoinsMap mapKeep(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), resource.get());
+    mapKeep.reserve(nKeep[0] + nKeep[1]);
+    CCoinsMap mapDirty;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it = cacheCoins.erase(it)) {
+        size_t& nKeepLeft = nKeep[(it->second.flags & CCoinsCacheEntry::FRESH) ? 0 : 1];
+        const bool fKeep = !it->second.coin.IsSpent() && nKeepLeft > 0;
+        if (fKeep)
+            nKeepLeft--;
+        else
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry entry(fKeep ? Coin(it->second.coin) : std::move(it->second.coin));
+            entry.flags = it->second.flags;
+            mapDirty.emplace(it->first, std::move(entry));
+        }
+        if (fKeep)
+            mapKeep.emplace(std::piecewise_construct, std::forward_as_tuple(it->first), std::forward_as_tuple(std::move(it->second.coin)));
+    }
+    cacheCoins.~CCoinsMap();
+    ::new (&cacheCoins) CCoinsMap(std::move(mapKeep));
+    m_cache_coins_memory_resource = std::move(resource);
+    return mapDirty;
+}
+
+void CCoinsViewCache::ReallocateCache()
+{
+    assert(cacheCoins.empty());
+    cacheCoins.~CCoinsMap();
+    m_cache_coins_memory_resource.reset(new CCoinsMapMemoryResource());
+    ::new (&cacheCoins) CCoinsMap(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), m_cache_coins_memory_resource.get());
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
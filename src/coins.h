@@ -15,6 +15,7 @@
 #include <uint256.h>
 
 #include <assert.h>
+#include <memory>
 #include <stdint.h>
 
 #include <unordered_map>
@@ -119,7 +120,16 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The entries of a CCoinsMap are allocated from a PoolResource rather than one
+ * by one with malloc. Blocks up to the size of a map node (the key/value pair,
+ * the next pointer and the cached hash, with some slack for other standard
+ * libraries) come from the pool.
+ */
+typedef std::pair<const COutPoint, CCoinsCacheEntry> CoinsCachePair;
+typedef PoolAllocator<CoinsCachePair, sizeof(CoinsCachePair) + sizeof(void*) * 4> CCoinsMapAllocator;
+typedef CCoinsMapAllocator::ResourceType CCoinsMapMemoryResource;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -206,6 +216,7 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    mutable std::unique_ptr<CCoinsMapMemoryResource> m_cache_coins_memory_resource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
@@ -236,6 +247,14 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Cache a coin that was read from the backing CCoinsView ahead of time, as
+     * if it had been fetched on a cache miss. The coin must be the unspent
+     * version the backing view currently has. Nothing happens if the cache
+     * already has an entry for the outpoint.
+     */
+    void AddFetchedCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -268,6 +287,17 @@ public:
      */
     bool Flush();
 
+    /**
+     * Take the modified entries out of this cache, for the caller to write to the
+     * base, instead of writing them and emptying the cache like Flush. Unspent
+     * entries stay in the cache as unmodified ones as long as they and the taken
+     * entries fit in nMaxUsage bytes, those created since the last flush first,
+     * as they are the most likely to be spent soon. The kept entries move to a
+     * fresh memory resource, so that the cache's usage drops to what they take.
+     * Entries that are taken out must be readable from the base from now on.
+     */
+    CCoinsMap TakeDirtyEntries(size_t nMaxUsage);
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
@@ -280,6 +310,9 @@ public:
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
+    //! Give the memory of an emptied cache back, which its memory resource would otherwise keep for reuse
+    void ReallocateCache();
+
     /**
      * Amount of digibytes coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -0,0 +1,158 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinstats.h>
+
+#include <primitives/block.h>
+#include <streams.h>
+#include <txdb.h>
+#include <version.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <thread>
+
+/** Serialize a coin the way it is hashed into the MuHash of the set. */
+static void SerializeCoin(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << static_cast<uint32_t>(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+static Span<const unsigned char> AsBytes(const CDataStream& ss)
+{
+    return Span<const unsigned char>(reinterpret_cast<const unsigned char*>(ss.data()), ss.size());
+}
+
+static uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+           2 /* scriptPubKey len */ + scriptPubKey.size() /* scriptPubKey */;
+}
+
+void CUTXOSetStats::AddCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoin(ss, outpoint, coin);
+    muhash.Insert(AsBytes(ss));
+    nTransactionOutputs++;
+    nTotalAmount += coin.out.nValue;
+    nBogoSize += GetBogoSize(coin.out.scriptPubKey);
+}
+
+void CUTXOSetStats::RemoveCoin(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    SerializeCoin(ss, outpoint, coin);
+    muhash.Remove(AsBytes(ss));
+    nTransactionOutputs--;
+    nTotalAmount -= coin.out.nValue;
+    nBogoSize -= GetBogoSize(coin.out.scriptPubKey);
+}
+
+void CUTXOSetStats::ApplyBlock(const CBlock& block, int nHeight, const std::vector<std::pair<COutPoint, Coin>>& vSpent, bool fConnect)
+{
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+    std::set<COutPoint> setSpentInBlock;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (setBlockTxids.count(txin.prevout.hash))
+                setSpentInBlock.insert(txin.prevout);
+        }
+    }
+
+    for (const auto& tx : block.vtx) {
+        for (size_t i = 0; i < tx->vout.size(); i++) {
+            const COutPoint outpoint(tx->GetHash(), i);
+            // Like AddCoins, which never adds unspendable outputs to the set
+            if (tx->vout[i].scriptPubKey.IsUnspendable() || setSpentInBlock.count(outpoint))
+                continue;
+            const Coin coin(tx->vout[i], nHeight, tx->IsCoinBase());
+            if (fConnect)
+                AddCoin(outpoint, coin);
+            else
+                RemoveCoin(outpoint, coin);
+        }
+    }
+    for (const auto& spent : vSpent) {
+        if (fConnect)
+            RemoveCoin(spent.first, spent.second);
+        else
+            AddCoin(spent.first, spent.second);
+    }
+    hashBlock = fConnect ? block.GetHash() : block.hashPrevBlock;
+}
+
+CUTXOSetStats& CUTXOSetStats::operator+=(const CUTXOSetStats& other)
+{
+    nTransactionOutputs += other.nTransactionOutputs;
+    nTotalAmount += other.nTotalAmount;
+    nBogoSize += other.nBogoSize;
+    muhash *= other.muhash;
+    return *this;
+}
+
+uint256 CUTXOSetStats::GetMuHash() const
+{
+    MuHash3072 final_muhash = muhash;
+    uint256 hash;
+    final_muhash.Finalize(hash);
+    return hash;
+}
+
+std::vector<std::pair<COutPoint, Coin>> GetBlockSpentCoins(const CBlock& block, const CCoinsViewCache& view)
+{
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+    std::vector<std::pair<COutPoint, Coin>> vSpent;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!setBlockTxids.count(txin.prevout.hash))
+                vSpent.emplace_back(txin.prevout, view.AccessCoin(txin.prevout));
+        }
+    }
+    return vSpent;
+}
+
+bool ComputeUTXOSetStats(const CCoinsViewDB& view, CUTXOSetStats& stats, int nThreads)
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = view.Cursors(std::max(nThreads, 1));
+    std::vector<CUTXOSetStats> vShardStats(cursors.size());
+    std::vector<char> vShardOk(cursors.size(), false);
+    auto worker = [&](size_t shard) {
+        CCoinsViewCursor* pcursor = cursors[shard].get();
+        for (; pcursor->Valid(); pcursor->Next()) {
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin))
+                return;
+            vShardStats[shard].AddCoin(key, coin);
+        }
+        vShardOk[shard] = true;
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < cursors.size(); i++)
+        threads.emplace_back(worker, i);
+    worker(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    stats = CUTXOSetStats();
+    stats.hashBlock = cursors[0]->GetBestBlock();
+    for (size_t i = 0; i < cursors.size(); i++) {
+        if (!vShardOk[i])
+            return false;
+        stats += vShardStats[i];
+    }
+    return true;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIGIBYTE_COINSTATS_H
+#define DIGIBYTE_COINSTATS_H
+
+#include <amount.h>
+#include <coins.h>
+#include <crypto/muhash.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+class CBlock;
+class CCoinsViewDB;
+
+/**
+ * Totals and a rolling MuHash3072 of the UTXO set as of hashBlock. They are
+ * updated as blocks are connected and disconnected, instead of being
+ * recomputed from the whole set like gettxoutsetinfo does.
+ */
+struct CUTXOSetStats
+{
+    uint256 hashBlock;
+    uint64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+    uint64_t nBogoSize;
+    MuHash3072 muhash;
+
+    CUTXOSetStats() : nTransactionOutputs(0), nTotalAmount(0), nBogoSize(0) {}
+
+    void AddCoin(const COutPoint& outpoint, const Coin& coin);
+    void RemoveCoin(const COutPoint& outpoint, const Coin& coin);
+
+    /**
+     * Apply the coins created and spent by a block at height nHeight. vSpent
+     * holds the coins it spends that were created before it, as returned by
+     * GetBlockSpentCoins; coins both created and spent by the block cancel out.
+     */
+    void ApplyBlock(const CBlock& block, int nHeight, const std::vector<std::pair<COutPoint, Coin>>& vSpent, bool fConnect);
+
+    /** Add the stats of a disjoint part of the set; hashBlock is kept. */
+    CUTXOSetStats& operator+=(const CUTXOSetStats& other);
+
+    /** Final hash of the set. */
+    uint256 GetMuHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+        READWRITE(nBogoSize);
+        READWRITE(muhash);
+    }
+};
+
+/**
+ * The coins spent by block that were created before it, looked up in view.
+ * Call this before connecting the block, or after disconnecting it.
+ */
+std::vector<std::pair<COutPoint, Coin>> GetBlockSpentCoins(const CBlock& block, const CCoinsViewCache& view);
+
+/** Compute the stats of the whole set in view from scratch, on nThreads threads. */
+bool ComputeUTXOSetStats(const CCoinsViewDB& view, CUTXOSetStats& stats, int nThreads);
+
+#endif // DIGIBYTE_COINSTATS_H
@@ -0,0 +1,82 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// CubeHash16/32-512 of a 64 byte input, as used by the qubit stages. This is a
+// translation to AVX2 of cubehash.c, holding the 32 word state in four registers.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace qubit_avx2 {
+namespace {
+
+alignas(32) const uint32_t IV512[32] = {
+    0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E, 0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+    0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537, 0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+    0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532, 0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+    0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576, 0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44
+};
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline RotL(__m256i x, int n) { return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+/** Words 0-15 of the state are in a0 and a1, words 16-31 in b0 and b1. */
+void inline Rounds(__m256i& a0, __m256i& a1, __m256i& b0, __m256i& b1, int rounds)
+{
+    for (int r = 0; r < rounds; r++) {
+        b0 = Add(b0, a0);
+        b1 = Add(b1, a1);
+        // Rotate by 7 and swap x[i] with x[i ^ 8]
+        __m256i t = RotL(a0, 7);
+        a0 = RotL(a1, 7);
+        a1 = t;
+        a0 = Xor(a0, b0);
+        a1 = Xor(a1, b1);
+        // Swap x[16 + i] with x[16 + (i ^ 2)]
+        b0 = _mm256_shuffle_epi32(b0, 0x4E);
+        b1 = _mm256_shuffle_epi32(b1, 0x4E);
+        b0 = Add(b0, a0);
+        b1 = Add(b1, a1);
+        // Rotate by 11 and swap x[i] with x[i ^ 4]
+        a0 = _mm256_permute4x64_epi64(RotL(a0, 11), 0x4E);
+        a1 = _mm256_permute4x64_epi64(RotL(a1, 11), 0x4E);
+        a0 = Xor(a0, b0);
+        a1 = Xor(a1, b1);
+        // Swap x[16 + i] with x[16 + (i ^ 1)]
+        b0 = _mm256_shuffle_epi32(b0, 0xB1);
+        b1 = _mm256_shuffle_epi32(b1, 0xB1);
+    }
+}
+
+}
+
+void Cubehash512_64(const unsigned char* in, unsigned char* out)
+{
+    __m256i a0 = _mm256_load_si256((const __m256i*)IV512);
+    __m256i a1 = _mm256_load_si256((const __m256i*)(IV512 + 8));
+    __m256i b0 = _mm256_load_si256((const __m256i*)(IV512 + 16));
+    __m256i b1 = _mm256_load_si256((const __m256i*)(IV512 + 24));
+
+    // Two 32 byte message blocks, then the padding block
+    a0 = Xor(a0, _mm256_loadu_si256((const __m256i*)in));
+    Rounds(a0, a1, b0, b1, 16);
+    a0 = Xor(a0, _mm256_loadu_si256((const __m256i*)(in + 32)));
+    Rounds(a0, a1, b0, b1, 16);
+    a0 = Xor(a0, _mm256_setr_epi32(0x80, 0, 0, 0, 0, 0, 0, 0));
+    Rounds(a0, a1, b0, b1, 16);
+
+    // Finalization
+    b1 = Xor(b1, _mm256_setr_epi32(0, 0, 0, 0, 0, 0, 0, 1));
+    Rounds(a0, a1, b0, b1, 160);
+
+    _mm256_storeu_si256((__m256i*)out, a0);
+    _mm256_storeu_si256((__m256i*)(out + 32), a1);
+}
+
+}
+
+#endif
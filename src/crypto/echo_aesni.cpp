@@ -0,0 +1,87 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// ECHO-512 of a 64 byte input, as used by the last qubit stage. This is a
+// translation of echo.c to AES-NI; the input always fits in a single block.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace qubit_aesni {
+namespace {
+
+/** Multiply every byte by x in GF(2^8), as in AES MixColumns. */
+__m128i inline Mul2(__m128i x)
+{
+    const __m128i poly = _mm_set1_epi8(0x1B);
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), poly));
+}
+
+void inline MixColumn(__m128i W[16], int a, int b, int c, int d)
+{
+    const __m128i ab = _mm_xor_si128(W[a], W[b]);
+    const __m128i bc = _mm_xor_si128(W[b], W[c]);
+    const __m128i cd = _mm_xor_si128(W[c], W[d]);
+    const __m128i abx = Mul2(ab);
+    const __m128i bcx = Mul2(bc);
+    const __m128i cdx = Mul2(cd);
+    const __m128i wa = W[a], wc = W[c], wd = W[d];
+    W[a] = _mm_xor_si128(_mm_xor_si128(abx, bc), wd);
+    W[b] = _mm_xor_si128(_mm_xor_si128(bcx, wa), cd);
+    W[c] = _mm_xor_si128(_mm_xor_si128(cdx, ab), wd);
+    W[d] = _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(abx, bcx), _mm_xor_si128(cdx, ab)), wc);
+}
+
+}
+
+void Echo512_64(const unsigned char* in, unsigned char* out)
+{
+    // 512 bits of message in this block; also the output length for the IV and padding
+    const __m128i counter = _mm_set_epi64x(0, 512);
+    __m128i M[8];
+    for (int i = 0; i < 4; i++)
+        M[i] = _mm_loadu_si128((const __m128i*)(in + 16 * i));
+    M[4] = _mm_set_epi32(0, 0, 0, 0x80);
+    M[5] = _mm_setzero_si128();
+    M[6] = _mm_set_epi32(512 << 16, 0, 0, 0);
+    M[7] = counter;
+
+    __m128i W[16];
+    for (int i = 0; i < 8; i++) {
+        W[i] = counter;
+        W[i + 8] = M[i];
+    }
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set_epi64x(0, 1);
+    __m128i K = counter;
+    for (int r = 0; r < 10; r++) {
+        // BIG.SubWords
+        for (int i = 0; i < 16; i++) {
+            W[i] = _mm_aesenc_si128(_mm_aesenc_si128(W[i], K), zero);
+            K = _mm_add_epi64(K, one);
+        }
+        // BIG.ShiftRows
+        __m128i t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+        t = W[2]; W[2] = W[10]; W[10] = t;
+        t = W[6]; W[6] = W[14]; W[14] = t;
+        t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+        // BIG.MixColumns
+        MixColumn(W, 0, 1, 2, 3);
+        MixColumn(W, 4, 5, 6, 7);
+        MixColumn(W, 8, 9, 10, 11);
+        MixColumn(W, 12, 13, 14, 15);
+    }
+
+    for (int i = 0; i < 4; i++) {
+        const __m128i v = _mm_xor_si128(_mm_xor_si128(counter, M[i]), _mm_xor_si128(W[i], W[i + 8]));
+        _mm_storeu_si128((__m128i*)(out + 16 * i), v);
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Groestl-512 of an 80 byte block header, as used by the groestl algo. The
+// 1024 bit state is held as its eight rows of 16 bytes. Groestl uses the AES
+// S-box: aesenclast with a zero key is SubBytes after AES ShiftRows, so each
+// row is first shuffled with the inverse of that, combined with the rotation
+// of ShiftBytes.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace qubit_aesni {
+namespace {
+
+const int SHIFT_P[8] = {0, 1, 2, 3, 4, 5, 6, 11};
+const int SHIFT_Q[8] = {1, 3, 5, 11, 0, 2, 4, 6};
+
+/** Multiply every byte by x in GF(2^8), with the AES polynomial. */
+__m128i inline Mul2(__m128i x)
+{
+    const __m128i poly = _mm_set1_epi8(0x1B);
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(_mm_cmplt_epi8(x, _mm_setzero_si128()), poly));
+}
+
+/** Row i of MixBytes, from the rows x and their pair sums t = x[i] ^ x[i + 1]. */
+__m128i inline MixRow(const __m128i x[8], const __m128i t[8], int i)
+{
+    const __m128i s = _mm_xor_si128(x[(i + 2) & 7], t[(i + 6) & 7]);
+    const __m128i a = _mm_xor_si128(s, t[(i + 4) & 7]);
+    const __m128i b = _mm_xor_si128(s, _mm_xor_si128(t[i], t[(i + 5) & 7]));
+    const __m128i c = _mm_xor_si128(t[(i + 3) & 7], t[(i + 6) & 7]);
+    return _mm_xor_si128(a, Mul2(_mm_xor_si128(b, Mul2(c))));
+}
+
+/**
+ * MixBytes, the circulant matrix (02, 02, 03, 04, 05, 03, 05, 07) applied to
+ * every column. Row i becomes a ^ 2 * (b ^ 2 * c), where a, b and c sum the
+ * rows i + d whose coefficient has 1, 2 and 4 set. The rows are written out
+ * rather than looped over, as GCC at -O2 does not unroll such loops and would
+ * keep the state in memory.
+ */
+void inline MixBytes(__m128i x[8])
+{
+    const __m128i t[8] = {
+        _mm_xor_si128(x[0], x[1]), _mm_xor_si128(x[1], x[2]), _mm_xor_si128(x[2], x[3]), _mm_xor_si128(x[3], x[4]),
+        _mm_xor_si128(x[4], x[5]), _mm_xor_si128(x[5], x[6]), _mm_xor_si128(x[6], x[7]), _mm_xor_si128(x[7], x[0])
+    };
+    const __m128i y[8] = {
+        MixRow(x, t, 0), MixRow(x, t, 1), MixRow(x, t, 2), MixRow(x, t, 3),
+        MixRow(x, t, 4), MixRow(x, t, 5), MixRow(x, t, 6), MixRow(x, t, 7)
+    };
+    x[0] = y[0]; x[1] = y[1]; x[2] = y[2]; x[3] = y[3];
+    x[4] = y[4]; x[5] = y[5]; x[6] = y[6]; x[7] = y[7];
+}
+
+/** SubBytes and ShiftBytes of row i. */
+__m128i inline SubShift(__m128i x, const __m128i shuffle[8], int i)
+{
+    return _mm_aesenclast_si128(_mm_shuffle_epi8(x, shuffle[i]), _mm_setzero_si128());
+}
+
+/** The shuffles of the rows before SubBytes: AES InvShiftRows, then the rotation of ShiftBytes. */
+void RowShuffles(__m128i shuffle[8], const int shift[8])
+{
+    const __m128i inv_shift_rows = _mm_setr_epi8(0, 13, 10, 7, 4, 1, 14, 11, 8, 5, 2, 15, 12, 9, 6, 3);
+    for (int i = 0; i < 8; i++)
+        shuffle[i] = _mm_and_si128(_mm_add_epi8(inv_shift_rows, _mm_set1_epi8(shift[i])), _mm_set1_epi8(0x0f));
+}
+
+/** A round of the P permutation of Groestl-1024, whose constants rc are in row 0. */
+void inline RoundP(__m128i x[8], const __m128i shuffle[8], __m128i rc)
+{
+    x[0] = SubShift(_mm_xor_si128(x[0], rc), shuffle, 0);
+    x[1] = SubShift(x[1], shuffle, 1);
+    x[2] = SubShift(x[2], shuffle, 2);
+    x[3] = SubShift(x[3], shuffle, 3);
+    x[4] = SubShift(x[4], shuffle, 4);
+    x[5] = SubShift(x[5], shuffle, 5);
+    x[6] = SubShift(x[6], shuffle, 6);
+    x[7] = SubShift(x[7], shuffle, 7);
+    MixBytes(x);
+}
+
+/** A round of the Q permutation, which inverts all bytes and has its constants rc in row 7. */
+void inline RoundQ(__m128i x[8], const __m128i shuffle[8], __m128i rc)
+{
+    const __m128i ones = _mm_set1_epi8(0xff);
+    x[0] = SubShift(_mm_xor_si128(x[0], ones), shuffle, 0);
+    x[1] = SubShift(_mm_xor_si128(x[1], ones), shuffle, 1);
+    x[2] = SubShift(_mm_xor_si128(x[2], ones), shuffle, 2);
+    x[3] = SubShift(_mm_xor_si128(x[3], ones), shuffle, 3);
+    x[4] = SubShift(_mm_xor_si128(x[4], ones), shuffle, 4);
+    x[5] = SubShift(_mm_xor_si128(x[5], ones), shuffle, 5);
+    x[6] = SubShift(_mm_xor_si128(x[6], ones), shuffle, 6);
+    x[7] = SubShift(_mm_xor_si128(x[7], _mm_xor_si128(rc, ones)), shuffle, 7);
+    MixBytes(x);
+}
+
+}
+
+void Groestl512_80(const unsigned char* in, unsigned char* out)
+{
+    // The header and its padding fill one block, ending in the block count.
+    // Byte 8 * j + i of the block is column j of row i.
+    unsigned char block[128] = {0};
+    memcpy(block, in, 80);
+    block[80] = 0x80;
+    block[127] = 1;
+    alignas(16) unsigned char rows[8][16];
+    for (int j = 0; j < 16; j++) {
+        for (int i = 0; i < 8; i++)
+            rows[i][j] = block[8 * j + i];
+    }
+
+    __m128i m[8], h[8], p[8];
+    for (int i = 0; i < 8; i++) {
+        m[i] = _mm_load_si128((const __m128i*)rows[i]);
+        h[i] = _mm_setzero_si128();
+    }
+    // The IV is the output length, 512, in the last bytes of the state
+    h[6] = _mm_insert_epi8(h[6], 0x02, 15);
+
+    // h = P(h ^ m) ^ Q(m) ^ h, with the two independent permutations interleaved
+    __m128i shuffle_p[8], shuffle_q[8];
+    RowShuffles(shuffle_p, SHIFT_P);
+    RowShuffles(shuffle_q, SHIFT_Q);
+    for (int i = 0; i < 8; i++)
+        p[i] = _mm_xor_si128(h[i], m[i]);
+    // Column j of the round constants is j << 4, plus the round number
+    const __m128i columns = _mm_setr_epi8(0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90, 0xa0, 0xb0, 0xc0, 0xd0, 0xe0, 0xf0);
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i rc = columns;
+    for (int r = 0; r < 14; r++) {
+        RoundP(p, shuffle_p, rc);
+        RoundQ(m, shuffle_q, rc);
+        rc = _mm_add_epi8(rc, one);
+    }
+    for (int i = 0; i < 8; i++)
+        h[i] = _mm_xor_si128(h[i], _mm_xor_si128(p[i], m[i]));
+
+    // The output is the last 512 bits of P(h) ^ h, columns 8 to 15
+    for (int i = 0; i < 8; i++)
+        p[i] = h[i];
+    rc = columns;
+    for (int r = 0; r < 14; r++) {
+        RoundP(p, shuffle_p, rc);
+        rc = _mm_add_epi8(rc, one);
+    }
+    for (int i = 0; i < 8; i++)
+        _mm_store_si128((__m128i*)rows[i], _mm_xor_si128(p[i], h[i]));
+    for (int j = 8; j < 16; j++) {
+        for (int i = 0; i < 8; i++)
+            out[8 * (j - 8) + i] = rows[i][j];
+    }
+}
+
+}
+
+#endif
@@ -13,6 +13,9 @@
 #include <openssl/ripemd.h>
 #include <vector>
 
+/** Groestl-512 of an 80 byte header, using the implementation selected by QubitAutoDetect. */
+void Groestl512Header(const unsigned char* in, unsigned char* out);
+
 template<typename T1>
 inline uint256 HashGroestl(const T1 pbegin, const T1 pend)
 {
@@ -22,9 +25,13 @@ inline uint256 HashGroestl(const T1 pbegin, const T1 pend)
     uint512 hash1;
     uint256 hash2;
 
-    sph_groestl512_init(&ctx_groestl);
-    sph_groestl512(&ctx_groestl, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]));
-    sph_groestl512_close(&ctx_groestl, static_cast<void*>(&hash1));
+    if ((pend - pbegin) * sizeof(pbegin[0]) == 80) {
+        Groestl512Header((const unsigned char*)&pbegin[0], hash1.begin());
+    } else {
+        sph_groestl512_init(&ctx_groestl);
+        sph_groestl512(&ctx_groestl, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]));
+        sph_groestl512_close(&ctx_groestl, static_cast<void*>(&hash1));
+    }
 
     SHA256((unsigned char*)&hash1, 64, (unsigned char*)&hash2);
 
@@ -13,7 +13,7 @@ extern "C" {
 }
 
 template<typename T1>
-inline uint256 HashOdo(const T1 pbegin, const T1 pend, uint32_t key)
+inline uint256 HashOdo(const T1 pbegin, const T1 pend, const OdoCrypt& crypt)
 {
     char cipher[KeccakP800_stateSizeInBytes] = {};
     uint256 hash;
@@ -24,11 +24,17 @@ inline uint256 HashOdo(const T1 pbegin, const T1 pend, uint32_t key)
     memcpy(cipher, static_cast<const void*>(&pbegin[0]), len);
     cipher[len] = 1;
 
-    OdoCrypt(key).Encrypt(cipher, cipher);
+    crypt.Encrypt(cipher, cipher);
     KeccakP800_Permute_12rounds(cipher);
     memcpy(hash.data, cipher, hash.size());
 
     return hash;
 }
 
+template<typename T1>
+inline uint256 HashOdo(const T1 pbegin, const T1 pend, uint32_t key)
+{
+    return HashOdo(pbegin, pend, *GetOdoCrypt(key));
+}
+
 #endif
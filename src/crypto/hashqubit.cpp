@@ -0,0 +1,202 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <crypto/hashqubit.h>
+#include <crypto/hashgroestl.h>
+#include <crypto/common.h>
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace qubit_avx2
+{
+void Luffa512_80(const unsigned char* in, unsigned char* out);
+void Cubehash512_64(const unsigned char* in, unsigned char* out);
+void Simd512_64(const unsigned char* in, unsigned char* out);
+}
+
+namespace qubit_aesni
+{
+void Groestl512_80(const unsigned char* in, unsigned char* out);
+void Shavite512_64(const unsigned char* in, unsigned char* out);
+void Echo512_64(const unsigned char* in, unsigned char* out);
+}
+
+namespace {
+
+typedef void (*Hash512Fn)(const unsigned char* in, unsigned char* out);
+
+void Groestl512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_groestl512_context ctx;
+    sph_groestl512_init(&ctx);
+    sph_groestl512(&ctx, in, 80);
+    sph_groestl512_close(&ctx, out);
+}
+
+void Luffa512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_luffa512_context ctx;
+    sph_luffa512_init(&ctx);
+    sph_luffa512(&ctx, in, 80);
+    sph_luffa512_close(&ctx, out);
+}
+
+void Cubehash512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_cubehash512_context ctx;
+    sph_cubehash512_init(&ctx);
+    sph_cubehash512(&ctx, in, 64);
+    sph_cubehash512_close(&ctx, out);
+}
+
+void Shavite512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_shavite512_context ctx;
+    sph_shavite512_init(&ctx);
+    sph_shavite512(&ctx, in, 64);
+    sph_shavite512_close(&ctx, out);
+}
+
+void Simd512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_simd512_context ctx;
+    sph_simd512_init(&ctx);
+    sph_simd512(&ctx, in, 64);
+    sph_simd512_close(&ctx, out);
+}
+
+void Echo512Generic(const unsigned char* in, unsigned char* out)
+{
+    sph_echo512_context ctx;
+    sph_echo512_init(&ctx);
+    sph_echo512(&ctx, in, 64);
+    sph_echo512_close(&ctx, out);
+}
+
+Hash512Fn Groestl512 = Groestl512Generic;
+Hash512Fn Luffa512 = Luffa512Generic;
+Hash512Fn Cubehash512 = Cubehash512Generic;
+Hash512Fn Shavite512 = Shavite512Generic;
+Hash512Fn Simd512 = Simd512Generic;
+Hash512Fn Echo512 = Echo512Generic;
+
+/** Check an implementation against the portable one, on inputs of len bytes. */
+bool SelfTest(Hash512Fn hash, Hash512Fn generic, size_t len)
+{
+    unsigned char in[80], out[64], expected[64];
+    for (int n = 0; n < 8; n++) {
+        for (size_t i = 0; i < len; i++)
+            in[i] = (unsigned char)(i * 7 + n * 131 + 13);
+        hash(in, out);
+        generic(in, expected);
+        if (memcmp(out, expected, sizeof(out)) != 0)
+            return false;
+    }
+    return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
+} // namespace
+
+void Groestl512Header(const unsigned char* in, unsigned char* out)
+{
+    Groestl512(in, out);
+}
+
+void QubitLuffa512(const unsigned char* in, unsigned char* out)
+{
+    Luffa512(in, out);
+}
+
+void QubitCubehash512(const unsigned char* in, unsigned char* out)
+{
+    Cubehash512(in, out);
+}
+
+void QubitShavite512(const unsigned char* in, unsigned char* out)
+{
+    Shavite512(in, out);
+}
+
+void QubitSimd512(const unsigned char* in, unsigned char* out)
+{
+    Simd512(in, out);
+}
+
+void QubitEcho512(const unsigned char* in, unsigned char* out)
+{
+    Echo512(in, out);
+}
+
+std::string QubitAutoDetect()
+{
+    std::string ret = "standard";
+    Groestl512 = Groestl512Generic;
+    Luffa512 = Luffa512Generic;
+    Cubehash512 = Cubehash512Generic;
+    Shavite512 = Shavite512Generic;
+    Simd512 = Simd512Generic;
+    Echo512 = Echo512Generic;
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    uint32_t eax, ebx, ecx, edx;
+    bool have_aesni = false;
+    bool have_avx2 = false;
+    bool enabled_avx = false;
+
+    (void)AVXEnabled;
+    (void)have_aesni;
+    (void)have_avx2;
+    (void)enabled_avx;
+
+    __cpuid_count(1, 0, eax, ebx, ecx, edx);
+    have_aesni = ((ecx >> 19) & 1) && ((ecx >> 25) & 1);
+    if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+        enabled_avx = AVXEnabled();
+    }
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+
+#if defined(ENABLE_AESNI) && !defined(BUILD_DIGIBYTE_INTERNAL)
+    if (have_aesni) {
+        Groestl512 = qubit_aesni::Groestl512_80;
+        Shavite512 = qubit_aesni::Shavite512_64;
+        Echo512 = qubit_aesni::Echo512_64;
+        ret = "aesni(groestl,shavite,echo)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_DIGIBYTE_INTERNAL)
+    if (have_avx2 && enabled_avx) {
+        Luffa512 = qubit_avx2::Luffa512_80;
+        Cubehash512 = qubit_avx2::Cubehash512_64;
+        Simd512 = qubit_avx2::Simd512_64;
+        ret += ",avx2(luffa,cubehash,simd)";
+    }
+#endif
+#endif
+
+    assert(SelfTest(Groestl512, Groestl512Generic, 80));
+    assert(SelfTest(Luffa512, Luffa512Generic, 80));
+    assert(SelfTest(Cubehash512, Cubehash512Generic, 64));
+    assert(SelfTest(Shavite512, Shavite512Generic, 64));
+    assert(SelfTest(Simd512, Simd512Generic, 64));
+    assert(SelfTest(Echo512, Echo512Generic, 64));
+    return ret;
+}
@@ -15,18 +15,30 @@
 
 #include <openssl/sha.h>
 #include <openssl/ripemd.h>
+#include <string>
 #include <vector>
 
+/** The first qubit stage on an 80 byte header, using the implementation selected by QubitAutoDetect. */
+void QubitLuffa512(const unsigned char* in, unsigned char* out);
+
+/** The 512-bit qubit stages hashing a 64 byte input, using the implementations selected by QubitAutoDetect. */
+void QubitCubehash512(const unsigned char* in, unsigned char* out);
+void QubitShavite512(const unsigned char* in, unsigned char* out);
+void QubitSimd512(const unsigned char* in, unsigned char* out);
+void QubitEcho512(const unsigned char* in, unsigned char* out);
+
+/**
+ * Autodetect the best available implementations of the qubit stages and of
+ * Groestl512Header. Returns a description of the selection.
+ */
+std::string QubitAutoDetect();
+
 
 template<typename T1>
 inline uint256 HashQubit(const T1 pbegin, const T1 pend)
 
 {
     sph_luffa512_context	 ctx_luffa;
-	sph_cubehash512_context  ctx_cubehash;
-	sph_shavite512_context	 ctx_shavite;
-	sph_simd512_context		 ctx_simd;
-	sph_echo512_context		 ctx_echo;
     static unsigned char pblank[1];
 
 #ifndef QT_NO_DEBUG
@@ -37,25 +49,21 @@ inline uint256 HashQubit(const T1 pbegin, const T1 pend)
 
     uint512 hash[5];
 
-    sph_luffa512_init(&ctx_luffa);
-    sph_luffa512 (&ctx_luffa, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]));
-    sph_luffa512_close(&ctx_luffa, static_cast<void*>(&hash[0]));
+    if ((pend - pbegin) * sizeof(pbegin[0]) == 80) {
+        QubitLuffa512((const unsigned char*)&pbegin[0], hash[0].begin());
+    } else {
+        sph_luffa512_init(&ctx_luffa);
+        sph_luffa512 (&ctx_luffa, (pbegin == pend ? pblank : static_cast<const void*>(&pbegin[0])), (pend - pbegin) * sizeof(pbegin[0]));
+        sph_luffa512_close(&ctx_luffa, static_cast<void*>(&hash[0]));
+    }
 
-    sph_cubehash512_init(&ctx_cubehash);
-    sph_cubehash512 (&ctx_cubehash, static_cast<const void*>(&hash[0]), 64);
-    sph_cubehash512_close(&ctx_cubehash, static_cast<void*>(&hash[1]));
+    QubitCubehash512(hash[0].begin(), hash[1].begin());
 
-    sph_shavite512_init(&ctx_shavite);
-    sph_shavite512(&ctx_shavite, static_cast<const void*>(&hash[1]), 64);
-    sph_shavite512_close(&ctx_shavite, static_cast<void*>(&hash[2]));
+    QubitShavite512(hash[1].begin(), hash[2].begin());
 
-    sph_simd512_init(&ctx_simd);
-    sph_simd512 (&ctx_simd, static_cast<const void*>(&hash[2]), 64);
-    sph_simd512_close(&ctx_simd, static_cast<void*>(&hash[3]));
+    QubitSimd512(hash[2].begin(), hash[3].begin());
 
-    sph_echo512_init(&ctx_echo);
-    sph_echo512 (&ctx_echo, static_cast<const void*>(&hash[3]), 64);
-    sph_echo512_close(&ctx_echo, static_cast<void*>(&hash[4]));
+    QubitEcho512(hash[3].begin(), hash[4].begin());
 
     return hash[4].trim256();
 }
@@ -0,0 +1,210 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Luffa-512 of an 80 byte block header, the first stage of qubit. The message
+// injection mixes the five 256 bit sub-states, so there each sub-state is one
+// register. The five sub-permutations are independent, so for them the state
+// is transposed to one register per word, with sub-state j in lane j.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace qubit_avx2 {
+namespace {
+
+alignas(32) const uint32_t IV[5][8] = {
+    {0x6d251e69, 0x44b051e0, 0x4eaa6fb4, 0xdbf78465, 0x6e292011, 0x90152df4, 0xee058139, 0xdef610bb},
+    {0xc3b44b95, 0xd9d2f256, 0x70eee9a0, 0xde099fa3, 0x5d9b0557, 0x8fc944b3, 0xcf1ccf0e, 0x746cd581},
+    {0xf7efc89d, 0x5dba5781, 0x04016ce5, 0xad659c05, 0x0306194f, 0x666d1836, 0x24aa230a, 0x8b264ae7},
+    {0x858075d5, 0x36d79cce, 0xe571f7d7, 0x204b1f67, 0x35870c6a, 0x57e9e923, 0x14bcb808, 0x7cde72ce},
+    {0x6c68e9be, 0x5ec41e22, 0xc825b7c7, 0xaffb4363, 0xf5df3999, 0x0fc688f1, 0xb07224cc, 0x03e86cea},
+};
+
+/** The round constants of words 0 and 4, lane j for sub-permutation j. */
+alignas(32) const uint32_t RC0[8][8] = {
+    {0x303994a6, 0xb6de10ed, 0xfc20d9d2, 0xb213afa5, 0xf0d2e9e3, 0, 0, 0},
+    {0xc0e65299, 0x70f47aae, 0x34552e25, 0xc84ebe95, 0xac11d7fa, 0, 0, 0},
+    {0x6cc33a12, 0x0707a3d4, 0x7ad8818f, 0x4e608a22, 0x1bcb66f2, 0, 0, 0},
+    {0xdc56983e, 0x1c1e8f51, 0x8438764a, 0x56d858fe, 0x6f2d9bc9, 0, 0, 0},
+    {0x1e00108f, 0x707a3d45, 0xbb6de032, 0x343b138f, 0x78602649, 0, 0, 0},
+    {0x7800423d, 0xaeb28562, 0xedb780c8, 0xd0ec4e3d, 0x8edae952, 0, 0, 0},
+    {0x8f5b7882, 0xbaca1589, 0xd9847356, 0x2ceb4882, 0x3b6ba548, 0, 0, 0},
+    {0x96e1db12, 0x40a46f3e, 0xa2c78434, 0xb3ad2208, 0xedae9520, 0, 0, 0},
+};
+alignas(32) const uint32_t RC4[8][8] = {
+    {0xe0337818, 0x01685f3d, 0xe25e72c1, 0xe028c9bf, 0x5090d577, 0, 0, 0},
+    {0x441ba90d, 0x05a17cf4, 0xe623bb72, 0x44756f91, 0x2d1925ab, 0, 0, 0},
+    {0x7f34d442, 0xbd09caca, 0x5c58a4a4, 0x7e8fce32, 0xb46496ac, 0, 0, 0},
+    {0x9389217f, 0xf4272b28, 0x1e38e2e7, 0x956548be, 0xd1925ab0, 0, 0, 0},
+    {0xe5a8bce6, 0x144ae5cc, 0x78e38b9d, 0xfe191be2, 0x29131ab6, 0, 0, 0},
+    {0x5274baf4, 0xfaa7ae2b, 0x27586719, 0x3cb226e5, 0x0fc053c3, 0, 0, 0},
+    {0x26889ba7, 0x2e48f1c1, 0x36eda57f, 0x5944a28e, 0x3f014f0c, 0, 0, 0},
+    {0x9a226e9d, 0xb923c704, 0x703aace7, 0xa1c4c355, 0xfc053c31, 0, 0, 0},
+};
+
+/** Swap the bytes of every 32 bit word, as Luffa is big endian. */
+__m256i inline Bswap32(__m256i x)
+{
+    return _mm256_shuffle_epi8(x, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                                   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+}
+
+/** Multiply a sub-state by x in GF(2^32)^8: rotate the words up by one and xor the top word into words 1, 3 and 4. */
+__m256i inline M2(__m256i s)
+{
+    const __m256i top = _mm256_permutevar8x32_epi32(s, _mm256_set1_epi32(7));
+    const __m256i up = _mm256_permutevar8x32_epi32(s, _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6));
+    return _mm256_xor_si256(up, _mm256_and_si256(top, _mm256_setr_epi32(0, -1, 0, -1, -1, 0, 0, 0)));
+}
+
+/** The message injection MI5 of luffa.c, on sub-states v and message block m. */
+void inline Inject(__m256i v[5], __m256i m)
+{
+    __m256i a = _mm256_xor_si256(_mm256_xor_si256(v[0], v[1]), _mm256_xor_si256(v[2], v[3]));
+    a = M2(_mm256_xor_si256(a, v[4]));
+    for (int j = 0; j < 5; j++)
+        v[j] = _mm256_xor_si256(v[j], a);
+
+    const __m256i b = _mm256_xor_si256(M2(v[0]), v[1]);
+    v[1] = _mm256_xor_si256(M2(v[1]), v[2]);
+    v[2] = _mm256_xor_si256(M2(v[2]), v[3]);
+    v[3] = _mm256_xor_si256(M2(v[3]), v[4]);
+    v[4] = _mm256_xor_si256(M2(v[4]), v[0]);
+    v[0] = _mm256_xor_si256(M2(b), v[4]);
+    v[4] = _mm256_xor_si256(M2(v[4]), v[3]);
+    v[3] = _mm256_xor_si256(M2(v[3]), v[2]);
+    v[2] = _mm256_xor_si256(M2(v[2]), v[1]);
+    v[1] = _mm256_xor_si256(M2(v[1]), b);
+
+    for (int j = 0; j < 5; j++) {
+        v[j] = _mm256_xor_si256(v[j], m);
+        m = M2(m);
+    }
+}
+
+/** Transpose the 8x8 matrix of 32 bit words in x. */
+void inline Transpose(__m256i x[8])
+{
+    const __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]), t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+    const __m256i t2 = _mm256_unpacklo_epi32(x[2], x[3]), t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+    const __m256i t4 = _mm256_unpacklo_epi32(x[4], x[5]), t5 = _mm256_unpackhi_epi32(x[4], x[5]);
+    const __m256i t6 = _mm256_unpacklo_epi32(x[6], x[7]), t7 = _mm256_unpackhi_epi32(x[6], x[7]);
+    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+    x[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    x[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    x[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    x[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    x[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    x[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    x[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    x[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+template <int n>
+__m256i inline Rotl(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+void inline SubCrumb(__m256i& a0, __m256i& a1, __m256i& a2, __m256i& a3)
+{
+    const __m256i ones = _mm256_set1_epi32(-1);
+    __m256i tmp = a0;
+    a0 = _mm256_or_si256(a0, a1);
+    a2 = _mm256_xor_si256(a2, a3);
+    a1 = _mm256_xor_si256(a1, ones);
+    a0 = _mm256_xor_si256(a0, a3);
+    a3 = _mm256_and_si256(a3, tmp);
+    a1 = _mm256_xor_si256(a1, a3);
+    a3 = _mm256_xor_si256(a3, a2);
+    a2 = _mm256_and_si256(a2, a0);
+    a0 = _mm256_xor_si256(a0, ones);
+    a2 = _mm256_xor_si256(a2, a1);
+    a1 = _mm256_or_si256(a1, a3);
+    tmp = _mm256_xor_si256(tmp, a1);
+    a3 = _mm256_xor_si256(a3, a2);
+    a2 = _mm256_and_si256(a2, a1);
+    a1 = _mm256_xor_si256(a1, a0);
+    a0 = tmp;
+}
+
+void inline MixWord(__m256i& u, __m256i& v)
+{
+    v = _mm256_xor_si256(v, u);
+    u = _mm256_xor_si256(Rotl<2>(u), v);
+    v = _mm256_xor_si256(Rotl<14>(v), u);
+    u = _mm256_xor_si256(Rotl<10>(u), v);
+    v = Rotl<1>(v);
+}
+
+/** The five sub-permutations P5 of luffa.c, on the transposed state w. */
+void inline Permute(__m256i w[8])
+{
+    // The tweak rotates words 4 to 7 of sub-state j left by j
+    const __m256i left = _mm256_setr_epi32(0, 1, 2, 3, 4, 0, 0, 0);
+    const __m256i right = _mm256_sub_epi32(_mm256_set1_epi32(32), left);
+    for (int i = 4; i < 8; i++)
+        w[i] = _mm256_or_si256(_mm256_sllv_epi32(w[i], left), _mm256_srlv_epi32(w[i], right));
+
+    for (int r = 0; r < 8; r++) {
+        SubCrumb(w[0], w[1], w[2], w[3]);
+        SubCrumb(w[5], w[6], w[7], w[4]);
+        MixWord(w[0], w[4]);
+        MixWord(w[1], w[5]);
+        MixWord(w[2], w[6]);
+        MixWord(w[3], w[7]);
+        w[0] = _mm256_xor_si256(w[0], _mm256_load_si256((const __m256i*)RC0[r]));
+        w[4] = _mm256_xor_si256(w[4], _mm256_load_si256((const __m256i*)RC4[r]));
+    }
+}
+
+/** One block: the injection of m into v, then the permutation. */
+void inline Round(__m256i v[5], __m256i m)
+{
+    Inject(v, m);
+    __m256i w[8] = {v[0], v[1], v[2], v[3], v[4], _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    Transpose(w);
+    Permute(w);
+    Transpose(w);
+    for (int j = 0; j < 5; j++)
+        v[j] = w[j];
+}
+
+__m256i inline Output(const __m256i v[5])
+{
+    return Bswap32(_mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(v[0], v[1]), _mm256_xor_si256(v[2], v[3])), v[4]));
+}
+
+}
+
+void Luffa512_80(const unsigned char* in, unsigned char* out)
+{
+    __m256i v[5];
+    for (int j = 0; j < 5; j++)
+        v[j] = _mm256_load_si256((const __m256i*)IV[j]);
+
+    // Two full blocks, then the last 16 bytes padded with 0x80 and zeros
+    unsigned char last[32] = {0};
+    memcpy(last, in + 64, 16);
+    last[16] = 0x80;
+    Round(v, Bswap32(_mm256_loadu_si256((const __m256i*)in)));
+    Round(v, Bswap32(_mm256_loadu_si256((const __m256i*)(in + 32))));
+    Round(v, Bswap32(_mm256_loadu_si256((const __m256i*)last)));
+
+    // Two blank rounds, each giving half of the output
+    Round(v, _mm256_setzero_si256());
+    _mm256_storeu_si256((__m256i*)out, Output(v));
+    Round(v, _mm256_setzero_si256());
+    _mm256_storeu_si256((__m256i*)(out + 32), Output(v));
+}
+
+}
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright (c) 2017-2020 The Bitcoin Core developers
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIGIBYTE_CRYPTO_MUHASH_H
+#define DIGIBYTE_CRYPTO_MUHASH_H
+
+#include <serialize.h>
+#include <span.h>
+#include <uint256.h>
+
+#include <stdint.h>
+
+/** A number modulo the prime 2^3072 - 1103717, as used by MuHash3072. */
+class Num3072
+{
+private:
+    void FullReduce();
+    bool IsOverflow() const;
+    Num3072 GetInverse() const;
+
+public:
+    static constexpr size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static constexpr int LIMBS = 48;
+    static constexpr int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static constexpr int LIMBS = 96;
+    static constexpr int LIMB_SIZE = 32;
+#endif
+    limb_t limbs[LIMBS];
+
+    static_assert(LIMB_SIZE * LIMBS == 3072, "Num3072 isn't 3072 bits");
+    static_assert(sizeof(double_limb_t) == sizeof(limb_t) * 2, "bad size for double_limb_t");
+    static_assert(sizeof(limb_t) * 8 == LIMB_SIZE, "LIMB_SIZE is incorrect");
+
+    void Multiply(const Num3072& a);
+    void Divide(const Num3072& a);
+    void SetToOne();
+    void Square();
+    void ToBytes(unsigned char (&out)[BYTE_SIZE]);
+
+    Num3072() { SetToOne(); }
+    explicit Num3072(const unsigned char (&data)[BYTE_SIZE]);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        for (limb_t& limb : limbs) {
+            READWRITE(limb);
+        }
+    }
+};
+
+/**
+ * A hash of a multiset of byte strings, which can be updated as elements are
+ * added and removed, in any order.
+ *
+ * Each element is hashed to a number modulo a 3072-bit prime, and the set
+ * hashes to the product of the numbers of its elements. Removals go into a
+ * separate denominator, so that both updates are a single multiplication and
+ * the expensive modular inverse only happens in Finalize. Hashes of disjoint
+ * sets combine with *=, and a subset is taken out again with /=.
+ *
+ * See https://cseweb.ucsd.edu/~mihir/papers/inchash.pdf for the construction
+ * and https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2017-May/014337.html
+ * for its use for the UTXO set.
+ */
+class MuHash3072
+{
+private:
+    Num3072 m_numerator;
+    Num3072 m_denominator;
+
+    static Num3072 ToNum3072(Span<const unsigned char> in);
+
+public:
+    /** The empty set. */
+    MuHash3072() noexcept {}
+
+    /** A singleton with variable sized data in it. */
+    explicit MuHash3072(Span<const unsigned char> in) noexcept;
+
+    /** Insert a single piece of data into the set. */
+    MuHash3072& Insert(Span<const unsigned char> in) noexcept;
+
+    /** Remove a single piece of data from the set. */
+    MuHash3072& Remove(Span<const unsigned char> in) noexcept;
+
+    /** Multiply, resulting in a hash of the union of the sets. */
+    MuHash3072& operator*=(const MuHash3072& mul) noexcept;
+
+    /** Divide, resulting in a hash of the difference of the sets. */
+    MuHash3072& operator/=(const MuHash3072& div) noexcept;
+
+    /** Finalize into a 32-byte hash. Does not change the set this object represents. */
+    void Finalize(uint256& out) noexcept;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(m_numerator);
+        READWRITE(m_denominator);
+    }
+};
+
+#endif // DIGIBYTE_CRYPTO_MUHASH_H
@@ -6,6 +6,9 @@
 #include "odocrypt.h"
 
 #include <algorithm>
+#include <list>
+#include <mutex>
+#include <utility>
 
 struct OdoRandom
 {
@@ -300,3 +303,42 @@ void OdoCrypt::ApplyRoundKey(uint64_t state[STATE_SIZE], int roundKey)
     for (int i = 0; i < STATE_SIZE; i++)
         state[i] ^= (roundKey >> i) & 1;
 }
+
+namespace {
+
+// Enough for the current epoch plus a few neighbours during header sync and reorgs.
+const size_t ODO_CACHE_SIZE = 8;
+
+std::mutex cs_odocache;
+// Most recently used first.
+std::list<std::pair<uint32_t, std::shared_ptr<const OdoCrypt>>> odocache;
+
+} // namespace
+
+std::shared_ptr<const OdoCrypt> GetOdoCrypt(uint32_t key)
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_odocache);
+        for (auto it = odocache.begin(); it != odocache.end(); ++it) {
+            if (it->first == key) {
+                odocache.splice(odocache.begin(), odocache, it);
+                return it->second;
+            }
+        }
+    }
+
+    // Construct outside the lock; if another thread raced us, keep its instance.
+    std::shared_ptr<const OdoCrypt> crypt = std::make_shared<const OdoCrypt>(key);
+
+    std::lock_guard<std::mutex> lock(cs_odocache);
+    for (auto it = odocache.begin(); it != odocache.end(); ++it) {
+        if (it->first == key) {
+            odocache.splice(odocache.begin(), odocache, it);
+            return it->second;
+        }
+    }
+    odocache.emplace_front(key, crypt);
+    if (odocache.size() > ODO_CACHE_SIZE)
+        odocache.pop_back();
+    return crypt;
+}
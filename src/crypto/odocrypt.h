@@ -8,6 +8,8 @@
 
 #include <stdint.h>
 
+#include <memory>
+
 class OdoCrypt
 {
 public:
@@ -94,4 +96,12 @@ private:
     static void ApplyRoundKey(uint64_t state[STATE_SIZE], int roundKey);
 };
 
+/**
+ * Return an OdoCrypt for the given key, shared with other callers.  Building
+ * the sboxes and pboxes is expensive while the key only changes once per
+ * shapechange interval, so the most recently used instances are kept around.
+ * Thread-safe.
+ */
+std::shared_ptr<const OdoCrypt> GetOdoCrypt(uint32_t key);
+
 #endif
@@ -28,12 +28,25 @@
  */
 
 #include "crypto/scrypt.h"
+#include "crypto/common.h"
 //#include "util.h"
+#include <assert.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <openssl/sha.h>
 
+#include <vector>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace scrypt_avx2
+{
+void ROMix_8way(uint32_t* X, uint32_t* V);
+}
+
 #if defined(USE_SSE2) && !defined(USE_SSE2_ALWAYS)
 #ifdef _MSC_VER
 // MSVC 64bit is unable to use inline asm
@@ -327,3 +340,115 @@ void scrypt_1024_1_1_256(const char *input, char *output)
 	char scratchpad[SCRYPT_SCRATCHPAD_SIZE];
     scrypt_1024_1_1_256_sp(input, output, scratchpad);
 }
+
+// Multi-way ROMix core, selected by ScryptAutoDetect. Operates on `ways`
+// instances whose words are interleaved by lane.
+static void (*ROMix_multi)(uint32_t* X, uint32_t* V) = nullptr;
+static int ROMix_ways = 1;
+
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t count)
+{
+	size_t n = 0;
+
+	if (ROMix_multi && count >= (size_t)ROMix_ways) {
+		const int ways = ROMix_ways;
+		std::vector<char> scratchpad(ways * 131072 + 63);
+		std::vector<uint8_t> B(ways * 128);
+		std::vector<uint32_t> X(ways * 32);
+		uint32_t *V = (uint32_t *)(((uintptr_t)(scratchpad.data()) + 63) & ~ (uintptr_t)(63));
+
+		for (; n + ways <= count; n += ways) {
+			for (int l = 0; l < ways; l++) {
+				const uint8_t *in = (const uint8_t *)input + 80 * (n + l);
+				PBKDF2_SHA256(in, 80, in, 80, 1, &B[128 * l], 128);
+				for (int k = 0; k < 32; k++)
+					X[k * ways + l] = le32dec(&B[128 * l + 4 * k]);
+			}
+
+			ROMix_multi(X.data(), V);
+
+			for (int l = 0; l < ways; l++) {
+				const uint8_t *in = (const uint8_t *)input + 80 * (n + l);
+				for (int k = 0; k < 32; k++)
+					le32enc(&B[128 * l + 4 * k], X[k * ways + l]);
+				PBKDF2_SHA256(in, 80, &B[128 * l], 128, 1, (uint8_t *)output + 32 * (n + l), 32);
+			}
+		}
+	}
+
+	if (n < count) {
+		std::vector<char> scratchpad(SCRYPT_SCRATCHPAD_SIZE);
+		for (; n < count; n++)
+			scrypt_1024_1_1_256_sp(input + 80 * n, output + 32 * n, scratchpad.data());
+	}
+}
+
+namespace {
+
+/** Check that the multi-way implementation agrees with the single-way one. */
+bool SelfTest()
+{
+	static const size_t count = 9;
+	char input[80 * count];
+	char output[32 * count];
+	char expected[32];
+
+	for (size_t i = 0; i < sizeof(input); i++)
+		input[i] = (char)(i * 7 + 13);
+
+	scrypt_1024_1_1_256_multi(input, output, count);
+	for (size_t n = 0; n < count; n++) {
+		scrypt_1024_1_1_256(input + 80 * n, expected);
+		if (memcmp(output + 32 * n, expected, 32) != 0)
+			return false;
+	}
+	return true;
+}
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+/** Check whether the OS has enabled AVX registers. */
+bool AVXEnabled()
+{
+	uint32_t a, d;
+	__asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return (a & 6) == 6;
+}
+#endif
+
+} // namespace
+
+std::string ScryptAutoDetect()
+{
+	std::string ret = "standard";
+	ROMix_multi = nullptr;
+	ROMix_ways = 1;
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+	uint32_t eax, ebx, ecx, edx;
+	bool have_avx2 = false;
+	bool enabled_avx = false;
+
+	(void)AVXEnabled;
+	(void)have_avx2;
+	(void)enabled_avx;
+
+	__cpuid_count(1, 0, eax, ebx, ecx, edx);
+	if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+		enabled_avx = AVXEnabled();
+	}
+	if (__get_cpuid_max(0, nullptr) >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		have_avx2 = (ebx >> 5) & 1;
+	}
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_DIGIBYTE_INTERNAL)
+	if (have_avx2 && enabled_avx) {
+		ROMix_multi = scrypt_avx2::ROMix_8way;
+		ROMix_ways = 8;
+		ret = "avx2(8way)";
+	}
+#endif
+#endif
+
+	assert(SelfTest());
+	return ret;
+}
@@ -2,12 +2,20 @@
 #define SCRYPT_H
 #include <stdlib.h>
 #include <stdint.h>
+#include <string>
 
 static const int SCRYPT_SCRATCHPAD_SIZE = 131072 + 63;
 
 void scrypt_1024_1_1_256(const char *input, char *output);
 void scrypt_1024_1_1_256_sp_generic(const char *input, char *output, char *scratchpad);
 
+/** Hash count consecutive 80-byte inputs into count consecutive 32-byte outputs,
+ *  running several instances side by side when a multi-way implementation is available. */
+void scrypt_1024_1_1_256_multi(const char *input, char *output, size_t count);
+
+/** Autodetect the best available multi-way scrypt implementation. Returns its name. */
+std::string ScryptAutoDetect();
+
 #if defined(USE_SSE2)
 #if defined(_M_X64) || defined(__x86_64__) || defined(_M_AMD64) || (defined(MAC_OSX) && defined(__i386__))
 #define USE_SSE2_ALWAYS 1
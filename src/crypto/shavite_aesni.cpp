@@ -0,0 +1,96 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SHAvite-3-512 of a 64 byte input, as used by the qubit stages. This is a
+// translation of the small footprint c512() in shavite.c to AES-NI; the input
+// always fits in a single block.
+
+#ifdef ENABLE_AESNI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace qubit_aesni {
+namespace {
+
+alignas(16) const uint32_t IV512[16] = {
+    0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC, 0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+    0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47, 0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+}
+
+void Shavite512_64(const unsigned char* in, unsigned char* out)
+{
+    // Bit count of the message, and the 512 bit digest size in the last two bytes
+    const uint32_t c0 = 512, c1 = 0, c2 = 0, c3 = 0;
+    const __m128i zero = _mm_setzero_si128();
+
+    // Message expansion, four words per register
+    __m128i rk[112];
+    for (int i = 0; i < 4; i++)
+        rk[i] = _mm_loadu_si128((const __m128i*)(in + 16 * i));
+    rk[4] = _mm_set_epi32(0, 0, 0, 0x80);
+    rk[5] = zero;
+    rk[6] = _mm_set_epi32(c0 << 16, 0, 0, 0);
+    rk[7] = _mm_set_epi32(512 << 16, 0, 0, 0);
+
+    int q = 8;
+    for (;;) {
+        for (int s = 0; s < 4; s++) {
+            rk[q] = _mm_xor_si128(_mm_aesenc_si128(_mm_shuffle_epi32(rk[q - 8], 0x39), zero), rk[q - 1]);
+            if (q == 8)
+                rk[q] = _mm_xor_si128(rk[q], _mm_set_epi32(~c3, c2, c1, c0));
+            else if (q == 110)
+                rk[q] = _mm_xor_si128(rk[q], _mm_set_epi32(~c2, c3, c0, c1));
+            q++;
+            rk[q] = _mm_xor_si128(_mm_aesenc_si128(_mm_shuffle_epi32(rk[q - 8], 0x39), zero), rk[q - 1]);
+            if (q == 41)
+                rk[q] = _mm_xor_si128(rk[q], _mm_set_epi32(~c0, c1, c2, c3));
+            else if (q == 79)
+                rk[q] = _mm_xor_si128(rk[q], _mm_set_epi32(~c1, c0, c3, c2));
+            q++;
+        }
+        if (q == 112)
+            break;
+        for (int s = 0; s < 8; s++) {
+            rk[q] = _mm_xor_si128(rk[q - 8], _mm_alignr_epi8(rk[q - 1], rk[q - 2], 4));
+            q++;
+        }
+    }
+
+    const __m128i h0 = _mm_load_si128((const __m128i*)IV512);
+    const __m128i h1 = _mm_load_si128((const __m128i*)(IV512 + 4));
+    const __m128i h2 = _mm_load_si128((const __m128i*)(IV512 + 8));
+    const __m128i h3 = _mm_load_si128((const __m128i*)(IV512 + 12));
+    __m128i p0 = h0, p1 = h1, p2 = h2, p3 = h3;
+    const __m128i* k = rk;
+    for (int r = 0; r < 14; r++, k += 8) {
+        __m128i x = _mm_xor_si128(p1, k[0]);
+        x = _mm_aesenc_si128(x, k[1]);
+        x = _mm_aesenc_si128(x, k[2]);
+        x = _mm_aesenc_si128(x, k[3]);
+        p0 = _mm_xor_si128(p0, _mm_aesenc_si128(x, zero));
+        x = _mm_xor_si128(p3, k[4]);
+        x = _mm_aesenc_si128(x, k[5]);
+        x = _mm_aesenc_si128(x, k[6]);
+        x = _mm_aesenc_si128(x, k[7]);
+        p2 = _mm_xor_si128(p2, _mm_aesenc_si128(x, zero));
+
+        const __m128i t = p3;
+        p3 = p2;
+        p2 = p1;
+        p1 = p0;
+        p0 = t;
+    }
+
+    _mm_storeu_si128((__m128i*)out, _mm_xor_si128(h0, p0));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_xor_si128(h1, p1));
+    _mm_storeu_si128((__m128i*)(out + 32), _mm_xor_si128(h2, p2));
+    _mm_storeu_si128((__m128i*)(out + 48), _mm_xor_si128(h3, p3));
+}
+
+}
+
+#endif
@@ -0,0 +1,303 @@
+// Copyright (c) 2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// SIMD-512 of a 64 byte hash, the fourth stage of qubit. The 256 point number
+// theoretic transform of the message, modulo 257 with root 41, is done as 16 by
+// 16: as 41^16 = 2, both 16 point transforms only shift, and the twiddles
+// between them are the only multiplications. The four 256 bit words of the
+// state A, B, C and D are one register each, so a step runs all eight lanes.
+// The last block of a 64 byte message only holds its length, so its expanded
+// message is the same every time.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+namespace qubit_avx2 {
+namespace {
+
+alignas(32) const uint32_t IV[32] = {
+    0x0ba16b95, 0x72f999ad, 0x9fecc2ae, 0xba3264fc, 0x5e894929, 0x8e9f30e5, 0x2f1daa37, 0xf0f2c558,
+    0xac506643, 0xa90635a5, 0xe25b878b, 0xaab7878f, 0x88817f7a, 0x0a02892b, 0x559a7550, 0x598f657e,
+    0x7eef60a1, 0x6b70e3e8, 0x9c1714d1, 0xb958e2a8, 0xab02675e, 0xed1c014f, 0xcd8d65bb, 0xfdb7a257,
+    0x09254899, 0xd699c7bc, 0x9019b6dc, 0x2b9022e4, 0x8fa14956, 0x21bf9bd3, 0xb94d0943, 0x6ffddc22,
+};
+
+/** The offsets added to the transform of a block, yoff_b_n and yoff_b_f of simd.c, then 41^(i * k). */
+alignas(32) const int32_t YOFF_N[256] = {
+      1, 163,  98,  40,  95,  65,  58, 202,  30,   7, 113, 172,  23, 151, 198, 149,
+    129, 210,  49,  20, 176, 161,  29, 101,  15, 132, 185,  86, 140, 204,  99, 203,
+    193, 105, 153,  10,  88, 209, 143, 179, 136,  66, 221,  43,  70, 102, 178, 230,
+    225, 181, 205,   5,  44, 233, 200, 218,  68,  33, 239, 150,  35,  51,  89, 115,
+    241, 219, 231, 131,  22, 245, 100, 109,  34, 145, 248,  75, 146, 154, 173, 186,
+    249, 238, 244, 194,  11, 251,  50, 183,  17, 201, 124, 166,  73,  77, 215,  93,
+    253, 119, 122,  97, 134, 254,  25, 220, 137, 229,  62,  83, 165, 167, 236, 175,
+    255, 188,  61, 177,  67, 127, 141, 110, 197, 243,  31, 170, 211, 212, 118, 216,
+    256,  94, 159, 217, 162, 192, 199,  55, 227, 250, 144,  85, 234, 106,  59, 108,
+    128,  47, 208, 237,  81,  96, 228, 156, 242, 125,  72, 171, 117,  53, 158,  54,
+     64, 152, 104, 247, 169,  48, 114,  78, 121, 191,  36, 214, 187, 155,  79,  27,
+     32,  76,  52, 252, 213,  24,  57,  39, 189, 224,  18, 107, 222, 206, 168, 142,
+     16,  38,  26, 126, 235,  12, 157, 148, 223, 112,   9, 182, 111, 103,  84,  71,
+      8,  19,  13,  63, 246,   6, 207,  74, 240,  56, 133,  91, 184, 180,  42, 164,
+      4, 138, 135, 160, 123,   3, 232,  37, 120,  28, 195, 174,  92,  90,  21,  82,
+      2,  69, 196,  80, 190, 130, 116, 147,  60,  14, 226,  87,  46,  45, 139,  41,
+};
+alignas(32) const int32_t YOFF_F[256] = {
+      2, 203, 156,  47, 118, 214, 107, 106,  45,  93, 212,  20, 111,  73, 162, 251,
+     97, 215, 249,  53, 211,  19,   3,  89,  49, 207, 101,  67, 151, 130, 223,  23,
+    189, 202, 178, 239, 253, 127, 204,  49,  76, 236,  82, 137, 232, 157,  65,  79,
+     96, 161, 176, 130, 161,  30,  47,   9, 189, 247,  61, 226, 248,  90, 107,  64,
+      0,  88, 131, 243, 133,  59, 113, 115,  17, 236,  33, 213,  12, 191, 111,  19,
+    251,  61, 103, 208,  57,  35, 148, 248,  47, 116,  65, 119, 249, 178, 143,  40,
+    189, 129,   8, 163, 204, 227, 230, 196, 205, 122, 151,  45, 187,  19, 227,  72,
+    247, 125, 111, 121, 140, 220,   6, 107,  77,  69,  10, 101,  21,  65, 149, 171,
+    255,  54, 101, 210, 139,  43, 150, 151, 212, 164,  45, 237, 146, 184,  95,   6,
+    160,  42,   8, 204,  46, 238, 254, 168, 208,  50, 156, 190, 106, 127,  34, 234,
+     68,  55,  79,  18,   4, 130,  53, 208, 181,  21, 175, 120,  25, 100, 192, 178,
+    161,  96,  81, 127,  96, 227, 210, 248,  68,  10, 196,  31,   9, 167, 150, 193,
+      0, 169, 126,  14, 124, 198, 144, 142, 240,  21, 224,  44, 245,  66, 146, 238,
+      6, 196, 154,  49, 200, 222, 109,   9, 210, 141, 192, 138,   8,  79, 114, 217,
+     68, 128, 249,  94,  53,  30,  27,  61,  52, 135, 106, 212,  70, 238,  30, 185,
+     10, 132, 146, 136, 117,  37, 251, 150, 180, 188, 247, 156, 236, 192, 108,  86,
+};
+alignas(32) const int32_t TWIDDLE[256] = {
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,  41, 139,  45,  46,  87, 226,  14,  60, 147, 116, 130, 190,  80, 196,  69,
+      1, 139,  46, 226,  60, 116, 190, 196,   2,  21,  92, 195, 120, 232, 123, 135,
+      1,  45, 226, 147, 190,  69,  21, 174, 120,   3, 135, 164, 184,  56, 207,  63,
+      1,  46,  60, 190,   2,  92, 120, 123,   4, 184, 240, 246,   8, 111, 223, 235,
+      1,  87, 116,  69,  92,  37, 135, 180, 240,  63,  84, 112, 235, 142,  18,  24,
+      1, 226, 190,  21, 120, 135, 184, 207,   8,   9, 235, 168, 189,  52, 187, 114,
+      1,  14, 196, 174, 123, 180, 207,  71, 223,  38,  18, 252, 187,  48, 158, 156,
+      1,  60,   2, 120,   4, 240,   8, 223,  16, 189,  32, 121,  64, 242, 128, 227,
+      1, 147,  21,   3, 184,  63,   9,  38, 189,  27, 114,  53,  81,  85, 159, 243,
+      1, 116,  92, 135, 240,  84, 235,  18,  32, 114, 117, 208, 227, 118,  67,  62,
+      1, 130, 195, 164, 246, 112, 168, 252, 121,  53, 208,  55, 211, 188,  25, 166,
+      1, 190, 120, 184,   8, 235, 189, 187,  64,  81, 227, 211, 255, 134,  17, 146,
+      1,  80, 232,  56, 111, 142,  52,  48, 242,  85, 118, 188, 134, 183, 248,  51,
+      1, 196, 123, 207, 223,  18, 187, 158, 128, 159,  67,  25,  17, 248,  35, 178,
+      1,  69, 135,  63, 235,  24, 114, 156, 227, 243,  62, 166, 146,  51, 178, 203,
+};
+
+/** (x mod 256) - x / 256, which keeps x modulo 257 and makes it smaller. */
+__m256i inline Reds1(__m256i x)
+{
+    return _mm256_sub_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xff)), _mm256_srai_epi32(x, 8));
+}
+
+/** (x mod 65536) + x / 65536, as 65536 is 1 modulo 257. */
+__m256i inline Reds2(__m256i x)
+{
+    return _mm256_add_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xffff)), _mm256_srai_epi32(x, 16));
+}
+
+/**
+ * The 16 point transform with root 2 of a, where each point is 16 values in
+ * two registers. The twiddles of a radix 2 transform of 16 points are 2^0 to
+ * 2^7, so they are shifts and never negate.
+ */
+void Transform16(__m256i a[16][2])
+{
+    static const int REVERSE[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+    __m256i b[16][2];
+    for (int i = 0; i < 16; i++) {
+        b[i][0] = a[REVERSE[i]][0];
+        b[i][1] = a[REVERSE[i]][1];
+    }
+    for (int h = 1; h < 16; h <<= 1) {
+        for (int s = 0; s < 16; s += 2 * h) {
+            for (int j = 0; j < h; j++) {
+                for (int k = 0; k < 2; k++) {
+                    const __m256i t = _mm256_slli_epi32(b[s + j + h][k], j * 8 / h);
+                    b[s + j + h][k] = _mm256_sub_epi32(b[s + j][k], t);
+                    b[s + j][k] = _mm256_add_epi32(b[s + j][k], t);
+                }
+            }
+        }
+    }
+    memcpy(a, b, sizeof(b));
+}
+
+/** Transpose the 8x8 matrix of 32 bit words in x. */
+void inline Transpose(__m256i x[8])
+{
+    const __m256i t0 = _mm256_unpacklo_epi32(x[0], x[1]), t1 = _mm256_unpackhi_epi32(x[0], x[1]);
+    const __m256i t2 = _mm256_unpacklo_epi32(x[2], x[3]), t3 = _mm256_unpackhi_epi32(x[2], x[3]);
+    const __m256i t4 = _mm256_unpacklo_epi32(x[4], x[5]), t5 = _mm256_unpackhi_epi32(x[4], x[5]);
+    const __m256i t6 = _mm256_unpacklo_epi32(x[6], x[7]), t7 = _mm256_unpackhi_epi32(x[6], x[7]);
+    const __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    const __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    const __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    const __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+    x[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    x[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    x[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    x[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    x[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    x[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    x[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    x[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/**
+ * Expand a 128 byte block into q[i] = yoff[i] + sum of x[k] * 41^(i * k), as
+ * the 16 bit values -128 to 128, with q[16 * r + c] in column c of row r.
+ * With k = k1 + 16 * k2 and i = i1 + 16 * i2, 41^(i * k) is
+ * 2^(i1 * k2) * 41^(i1 * k1) * 2^(i2 * k1).
+ */
+void Expand(const unsigned char x[128], const int32_t yoff[256], __m256i q[16])
+{
+    // Over k2, for every k1 in the lanes
+    __m256i a[16][2];
+    for (int k2 = 0; k2 < 8; k2++) {
+        a[k2][0] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(x + 16 * k2)));
+        a[k2][1] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(x + 16 * k2 + 8)));
+    }
+    for (int k2 = 8; k2 < 16; k2++)
+        a[k2][0] = a[k2][1] = _mm256_setzero_si256();
+    Transform16(a);
+    for (int i1 = 0; i1 < 16; i1++) {
+        for (int h = 0; h < 2; h++) {
+            const __m256i twiddle = _mm256_load_si256((const __m256i*)(TWIDDLE + 16 * i1 + 8 * h));
+            a[i1][h] = Reds1(_mm256_mullo_epi32(Reds1(Reds2(a[i1][h])), twiddle));
+        }
+    }
+
+    // Over k1, for every i1 in the lanes
+    __m256i b[16][2];
+    for (int h1 = 0; h1 < 2; h1++) {
+        for (int h2 = 0; h2 < 2; h2++) {
+            __m256i t[8];
+            for (int r = 0; r < 8; r++)
+                t[r] = a[8 * h1 + r][h2];
+            Transpose(t);
+            for (int c = 0; c < 8; c++)
+                b[8 * h2 + c][h1] = t[c];
+        }
+    }
+    Transform16(b);
+
+    for (int i2 = 0; i2 < 16; i2++) {
+        __m256i v[2];
+        for (int h = 0; h < 2; h++) {
+            v[h] = _mm256_add_epi32(b[i2][h], _mm256_load_si256((const __m256i*)(yoff + 16 * i2 + 8 * h)));
+            v[h] = Reds1(Reds1(Reds2(v[h])));
+            v[h] = _mm256_sub_epi32(v[h], _mm256_and_si256(_mm256_cmpgt_epi32(v[h], _mm256_set1_epi32(128)), _mm256_set1_epi32(257)));
+        }
+        q[i2] = _mm256_permute4x64_epi64(_mm256_packs_epi32(v[0], v[1]), 0xd8);
+    }
+}
+
+/**
+ * The 32 message words of the steps of the four rounds. Word n of a step in
+ * the first two rounds is q[2n] and q[2n + 1] of a row, each times 185 as 16
+ * bits; in the last two it pairs rows r and r + 8, each times 233.
+ */
+void MessageWords(const __m256i q[16], __m256i w[32])
+{
+    static const int ROWS[4][8] = {
+        {4, 6, 0, 2, 7, 5, 3, 1},
+        {15, 11, 12, 8, 9, 13, 10, 14},
+        {1, 2, 7, 4, 6, 5, 0, 3},
+        {6, 0, 1, 7, 3, 5, 4, 2},
+    };
+    const __m256i m185 = _mm256_set1_epi16(185), m233 = _mm256_set1_epi16(233);
+    for (int j = 0; j < 8; j++) {
+        w[j] = _mm256_mullo_epi16(q[ROWS[0][j]], m185);
+        w[8 + j] = _mm256_mullo_epi16(q[ROWS[1][j]], m185);
+        const __m256i lo = q[ROWS[2][j]], hi = q[ROWS[2][j] + 8];
+        w[16 + j] = _mm256_mullo_epi16(_mm256_blend_epi16(lo, _mm256_slli_epi32(hi, 16), 0xaa), m233);
+        const __m256i lo_odd = q[ROWS[3][j]], hi_odd = q[ROWS[3][j] + 8];
+        w[24 + j] = _mm256_mullo_epi16(_mm256_blend_epi16(_mm256_srli_epi32(lo_odd, 16), hi_odd, 0xaa), m233);
+    }
+}
+
+__m256i inline Rotl(__m256i x, int n)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+/**
+ * One step on all eight lanes: A is rotated by r, then becomes the rotation
+ * by s of D + w + f(A, B, C), plus the rotated A of lane n ^ p.
+ */
+void inline Step(__m256i s[4], __m256i w, bool maj, int r, int rs, int p)
+{
+    const __m256i a = s[0], b = s[1], c = s[2];
+    const __m256i f = maj ? _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(_mm256_or_si256(a, b), c))
+                          : _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(b, c), a), c);
+    const __m256i ta = Rotl(a, r);
+    const __m256i lanes = _mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(p));
+    const __m256i tt = _mm256_add_epi32(_mm256_add_epi32(s[3], w), f);
+    s[0] = _mm256_add_epi32(Rotl(tt, rs), _mm256_permutevar8x32_epi32(ta, lanes));
+    s[3] = c;
+    s[2] = b;
+    s[1] = ta;
+}
+
+/** The compression of a block m with message words w into the state s. */
+void Compress(__m256i s[4], const __m256i m[4], const __m256i w[32])
+{
+    static const int ROTATIONS[4][4] = {{3, 23, 17, 27}, {28, 19, 22, 7}, {29, 9, 15, 5}, {4, 13, 10, 25}};
+    static const int PERMUTATIONS[11] = {1, 6, 2, 3, 5, 7, 4, 1, 6, 2, 3};
+    const __m256i saved[4] = {s[0], s[1], s[2], s[3]};
+    for (int i = 0; i < 4; i++)
+        s[i] = _mm256_xor_si256(s[i], m[i]);
+    for (int round = 0; round < 4; round++) {
+        const int* p = ROTATIONS[round];
+        for (int j = 0; j < 8; j++)
+            Step(s, w[8 * round + j], j >= 4, p[j & 3], p[(j + 1) & 3], PERMUTATIONS[round + j]);
+    }
+    Step(s, saved[0], false, 4, 13, 5);
+    Step(s, saved[1], false, 13, 10, 7);
+    Step(s, saved[2], false, 10, 25, 4);
+    Step(s, saved[3], false, 25, 4, 1);
+}
+
+/** The message words of the last block, the bit length 512. */
+struct LengthBlock {
+    __m256i w[32];
+
+    LengthBlock()
+    {
+        unsigned char block[128] = {0};
+        block[1] = 512 >> 8;
+        __m256i q[16];
+        Expand(block, YOFF_F, q);
+        MessageWords(q, w);
+    }
+};
+
+}
+
+void Simd512_64(const unsigned char* in, unsigned char* out)
+{
+    static const LengthBlock length_block;
+
+    __m256i s[4];
+    for (int i = 0; i < 4; i++)
+        s[i] = _mm256_load_si256((const __m256i*)(IV + 8 * i));
+
+    unsigned char block[128] = {0};
+    memcpy(block, in, 64);
+    __m256i q[16], w[32];
+    Expand(block, YOFF_N, q);
+    MessageWords(q, w);
+    const __m256i m[4] = {_mm256_loadu_si256((const __m256i*)in), _mm256_loadu_si256((const __m256i*)(in + 32)),
+                          _mm256_setzero_si256(), _mm256_setzero_si256()};
+    Compress(s, m, w);
+
+    const __m256i length[4] = {_mm256_setr_epi32(512, 0, 0, 0, 0, 0, 0, 0), _mm256_setzero_si256(),
+                               _mm256_setzero_si256(), _mm256_setzero_si256()};
+    Compress(s, length, length_block.w);
+
+    _mm256_storeu_si256((__m256i*)out, s[0]);
+    _mm256_storeu_si256((__m256i*)(out + 32), s[1]);
+}
+
+}
+
+#endif
@@ -234,6 +234,18 @@ bool CDBWrapper::IsEmpty()
     return !(it->Valid());
 }
 
+std::vector<std::unique_ptr<CDBIterator>> CDBWrapper::NewSnapshotIterators(size_t count)
+{
+    leveldb::DB* db = pdb;
+    std::shared_ptr<const leveldb::Snapshot> snapshot(pdb->GetSnapshot(), [db](const leveldb::Snapshot* s) { db->ReleaseSnapshot(s); });
+    leveldb::ReadOptions options = iteroptions;
+    options.snapshot = snapshot.get();
+    std::vector<std::unique_ptr<CDBIterator>> iterators;
+    for (size_t i = 0; i < count; i++)
+        iterators.emplace_back(new CDBIterator(*this, pdb->NewIterator(options), snapshot));
+    return iterators;
+}
+
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() const { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
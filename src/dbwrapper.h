@@ -17,6 +17,9 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <memory>
+#include <vector>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
 
@@ -120,15 +123,18 @@ class CDBIterator
 private:
     const CDBWrapper &parent;
     leveldb::Iterator *piter;
+    //! Snapshot the iterator reads from, if it shares one with other iterators
+    std::shared_ptr<const leveldb::Snapshot> snapshot;
 
 public:
 
     /**
      * @param[in] _parent          Parent CDBWrapper instance.
      * @param[in] _piter           The original leveldb iterator.
+     * @param[in] _snapshot        Snapshot _piter reads from, released once unused.
      */
-    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter) :
-        parent(_parent), piter(_piter) { };
+    CDBIterator(const CDBWrapper &_parent, leveldb::Iterator *_piter, std::shared_ptr<const leveldb::Snapshot> _snapshot = nullptr) :
+        parent(_parent), piter(_piter), snapshot(std::move(_snapshot)) { };
     ~CDBIterator();
 
     bool Valid() const;
@@ -311,6 +317,12 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Return count iterators that all read the database as it is now, so that
+     * parts of it can be iterated in parallel.
+     */
+    std::vector<std::unique_ptr<CDBIterator>> NewSnapshotIterators(size_t count);
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
@@ -200,5 +200,7 @@ void RegenerateCommitments(CBlock& block, const CBlockIndex* pindexPrev, const C
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev, int algo);
+/** Re-derive the algo dependent header fields (version bits and target) of a block assembled for another algo */
+void UpdateAlgo(CBlockHeader* pblock, const CChainParams& chainparams, const CBlockIndex* pindexPrev, int algo);
 
 #endif // DIGIBYTE_MINER_H
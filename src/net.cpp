@@ -716,6 +716,8 @@ void CNode::copyStats(CNodeStats &stats)
         X(nRecvBytes);
     }
     X(fWhitelisted);
+    X(fSupportsDandelion);
+    X(nDandelionStemSent);
 
     // It is common for nodes with good ping times to suddenly become lagged,
     // due to a new block arriving or other large transfer.
@@ -1152,12 +1154,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         vNodes.push_back(pnode);
 
         // Dandelion: new inbound connection
-        vDandelionInbound.push_back(pnode);
-        CNode* pto = SelectFromDandelionDestinations();
-        if (pto!=nullptr) {
-            mDandelionRoutes.insert(std::make_pair(pnode, pto));
-        }
-        LogPrint(BCLog::DANDELION, "Added inbound Dandelion connection:\n%s", GetDandelionRoutingDataDebugString());
+        AddDandelionInbound(pnode);
     }
 }
 
@@ -1500,11 +1497,31 @@ bool CConnman::setLocalDandelionDestination()
     return isLocalDandelionDestinationSet();
 }
 
+void CConnman::AddDandelionInbound(CNode* pnode)
+{
+    LOCK(cs_vNodes);
+    vDandelionInbound.push_back(pnode);
+    CNode* pto = SelectFromDandelionDestinations();
+    if (pto!=nullptr) {
+        mDandelionRoutes.insert(std::make_pair(pnode, pto));
+    }
+    LogPrint(BCLog::DANDELION, "Added inbound Dandelion connection:\n%s", GetDandelionRoutingDataDebugString());
+}
+
+void CConnman::AddDandelionOutbound(CNode* pnode)
+{
+    LOCK(cs_vNodes);
+    vDandelionOutbound.push_back(pnode);
+    if (vDandelionDestination.size()<DANDELION_MAX_DESTINATIONS) {
+        vDandelionDestination.push_back(pnode);
+    }
+    LogPrint(BCLog::DANDELION, "Added outbound Dandelion connection:\n%s", GetDandelionRoutingDataDebugString());
+}
+
 CNode* CConnman::getDandelionDestination(CNode* pfrom) {
-    for (auto const& e : mDandelionRoutes) {
-        if (pfrom==e.first) {
-            return e.second;
-        }
+    auto it = mDandelionRoutes.find(pfrom);
+    if (it != mDandelionRoutes.end()) {
+        return it->second;
     }
     CNode* newPto = SelectFromDandelionDestinations();
     if (newPto!=nullptr) {
@@ -1527,30 +1544,60 @@ bool CConnman::localDandelionDestinationPushInventory(const CInv& inv) {
 }
 
 bool CConnman::insertDandelionEmbargo(const uint256& hash, const int64_t& embargo) {
+    LOCK(cs_dandelionEmbargo);
     auto pair = mDandelionEmbargo.insert(std::make_pair(hash, embargo));
+    if (pair.second) {
+        setDandelionEmbargoExpiry.insert(std::make_pair(embargo, hash));
+    }
     return pair.second;
 }
 
 bool CConnman::isTxDandelionEmbargoed(const uint256& hash) const {
-    auto pair = mDandelionEmbargo.find(hash);
-    if (pair != mDandelionEmbargo.end()) {
-        return true;
-    } else {
+    LOCK(cs_dandelionEmbargo);
+    return mDandelionEmbargo.count(hash) != 0;
+}
+
+bool CConnman::removeDandelionEmbargo(const uint256& hash) {
+    LOCK(cs_dandelionEmbargo);
+    auto iter = mDandelionEmbargo.find(hash);
+    if (iter == mDandelionEmbargo.end()) {
         return false;
     }
+    setDandelionEmbargoExpiry.erase(std::make_pair(iter->second, hash));
+    mDandelionEmbargo.erase(iter);
+    return true;
 }
 
-bool CConnman::removeDandelionEmbargo(const uint256& hash) {
-    bool removed = false;
-    for (auto iter=mDandelionEmbargo.begin(); iter!=mDandelionEmbargo.end();) {
-        if (iter->first==hash) {
-            iter = mDandelionEmbargo.erase(iter);
-            removed = true;
-        } else {
-            iter++;
-        }
+std::vector<uint256> CConnman::popExpiredDandelionEmbargoes(int64_t nTime) {
+    std::vector<uint256> vExpired;
+    LOCK(cs_dandelionEmbargo);
+    while (!setDandelionEmbargoExpiry.empty() && setDandelionEmbargoExpiry.begin()->first < nTime) {
+        const uint256& hash = setDandelionEmbargoExpiry.begin()->second;
+        vExpired.push_back(hash);
+        mDandelionEmbargo.erase(hash);
+        setDandelionEmbargoExpiry.erase(setDandelionEmbargoExpiry.begin());
     }
-    return removed;
+    return vExpired;
+}
+
+void CConnman::RecordDandelionStemRelay(uint64_t nCount, int64_t nLatencyMicros) {
+    nDandelionStemRelayed += nCount;
+    nDandelionStemLatencyMicros += nLatencyMicros;
+}
+
+void CConnman::RecordDandelionFluff() {
+    nDandelionFluffed++;
+}
+
+void CConnman::RecordDandelionEmbargoExpiry() {
+    nDandelionEmbargoExpired++;
+}
+
+void CConnman::GetDandelionStats(CDandelionStats& stats) const {
+    stats.nStemRelayed = nDandelionStemRelayed;
+    stats.nStemLatencyMicros = nDandelionStemLatencyMicros;
+    stats.nFluffed = nDandelionFluffed;
+    stats.nEmbargoExpired = nDandelionEmbargoExpired;
 }
 
 CNode* CConnman::SelectFromDandelionDestinations() const
@@ -2324,12 +2371,8 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
         vNodes.push_back(pnode);
         
         // Dandelion: new outbound connection
-        vDandelionOutbound.push_back(pnode);
-        if (vDandelionDestination.size()<DANDELION_MAX_DESTINATIONS) {
-            vDandelionDestination.push_back(pnode);
-        }
-        LogPrint(BCLog::DANDELION, "Added outbound Dandelion connection:\n%s", GetDandelionRoutingDataDebugString());
-        
+        AddDandelionOutbound(pnode);
+
         // Dandelion service discovery
         uint256 dummyHash;
         dummyHash.SetHex("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
@@ -3063,6 +3106,8 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nNextLocalAddrSend = 0;
     nNextAddrSend = 0;
     nNextInvSend = 0;
+    nNextDandelionInvSend = 0;
+    nDandelionStemSent = 0;
     fRelayTxes = false;
     fSentAddr = false;
     pfilter = MakeUnique<CBloomFilter>();
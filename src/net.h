@@ -22,6 +22,7 @@
 #include <sync.h>
 #include <uint256.h>
 #include <threadinterrupt.h>
+#include <utiltime.h>
 
 #include <atomic>
 #include <deque>
@@ -94,6 +95,10 @@ static const int DANDELION_SHUFFLE_INTERVAL = 600;
 static const int DANDELION_EMBARGO_MINIMUM = 10;
 /** The average additional embargo time beyond the minimum amount (seconds) */
 static const int DANDELION_EMBARGO_AVG_ADD = 20;
+/** How often expired Dandelion embargoes are looked for (in seconds) */
+static const int DANDELION_EMBARGO_CHECK_INTERVAL = 1;
+/** Average delay between stem inventory batches sent to a Dandelion destination (in seconds) */
+static const int DANDELION_INVENTORY_BROADCAST_INTERVAL = 1;
 
 typedef int64_t NodeId;
 
@@ -108,6 +113,16 @@ struct AddedNodeInfo
 class CNodeStats;
 class CClientUIInterface;
 
+struct CDandelionStats
+{
+    // Stem inventories sent, and the total time they spent queued (in microseconds)
+    uint64_t nStemRelayed = 0;
+    int64_t nStemLatencyMicros = 0;
+    // Transactions fluffed on receipt, and after their embargo ended
+    uint64_t nFluffed = 0;
+    uint64_t nEmbargoExpired = 0;
+};
+
 struct CSerializedNetMsg
 {
     CSerializedNetMsg() = default;
@@ -323,9 +338,11 @@ public:
 
     void WakeMessageHandler();
     
-    // Public Dandelion field
-    std::map<uint256, int64_t> mDandelionEmbargo;
     // Dandelion methods
+    void AddDandelionInbound(CNode* pnode);
+    void AddDandelionOutbound(CNode* pnode);
+    void CloseDandelionConnections(const CNode* const pnode);
+    void DandelionShuffle();
     bool isDandelionInbound(const CNode* const pnode) const;
     bool isLocalDandelionDestinationSet() const;
     bool setLocalDandelionDestination();
@@ -334,6 +351,12 @@ public:
     bool insertDandelionEmbargo(const uint256& hash, const int64_t& embargo);
     bool isTxDandelionEmbargoed(const uint256& hash) const;
     bool removeDandelionEmbargo(const uint256& hash);
+    /** Remove and return the transactions whose embargo ended before nTime, earliest first. */
+    std::vector<uint256> popExpiredDandelionEmbargoes(int64_t nTime);
+    void RecordDandelionStemRelay(uint64_t nCount, int64_t nLatencyMicros);
+    void RecordDandelionFluff();
+    void RecordDandelionEmbargoExpiry();
+    void GetDandelionStats(CDandelionStats& stats) const;
 
     /** Attempts to obfuscate tx time through exponentially distributed emitting.
         Works assuming that a single interval is used.
@@ -436,11 +459,19 @@ private:
     std::vector<CNode*> vDandelionDestination;
     CNode* localDandelionDestination = nullptr;
     std::map<CNode*, CNode*> mDandelionRoutes;
+    // Embargo end time of each Dandelion transaction, and the same entries
+    // ordered by end time so that expired ones are found without a scan
+    mutable CCriticalSection cs_dandelionEmbargo;
+    std::map<uint256, int64_t> mDandelionEmbargo GUARDED_BY(cs_dandelionEmbargo);
+    std::set<std::pair<int64_t, uint256>> setDandelionEmbargoExpiry GUARDED_BY(cs_dandelionEmbargo);
+    // Dandelion relay totals
+    std::atomic<uint64_t> nDandelionStemRelayed{0};
+    std::atomic<int64_t> nDandelionStemLatencyMicros{0};
+    std::atomic<uint64_t> nDandelionFluffed{0};
+    std::atomic<uint64_t> nDandelionEmbargoExpired{0};
     // Dandelion helper functions
     CNode* SelectFromDandelionDestinations() const;
-    void CloseDandelionConnections(const CNode* const pnode);
     std::string GetDandelionRoutingDataDebugString() const;
-    void DandelionShuffle();
     
     /** Services this instance offers */
     ServiceFlags nLocalServices;
@@ -600,6 +631,8 @@ public:
     CAddress addr;
     // Bind address of our side of the connection
     CAddress addrBind;
+    bool fSupportsDandelion;
+    uint64_t nDandelionStemSent;
 };
 
 
@@ -738,8 +771,9 @@ public:
     // Set of transaction ids we still have to announce.
     // They are sorted by the mempool before relay, so the order is not important.
     std::set<uint256> setInventoryTxToSend;
-    // List of Dandelion transaction ids to announce.
-    std::vector<uint256> vInventoryDandelionTxToSend;
+    // Dandelion transaction ids to announce, with the time they were queued.
+    // They are sent in batches, see nNextDandelionInvSend.
+    std::map<uint256, int64_t> mapInventoryDandelionTxToSend;
     // List of block ids we still have announce.
     // There is no final sorting before sending, as they are always sent immediately
     // and in the order requested.
@@ -748,6 +782,9 @@ public:
     std::set<uint256> setAskFor;
     std::multimap<int64_t, CInv> mapAskFor;
     int64_t nNextInvSend;
+    int64_t nNextDandelionInvSend;
+    // Number of Dandelion stem inventories announced to this peer
+    std::atomic<uint64_t> nDandelionStemSent;
     // Used for headers announcements - unfiltered blocks to relay
     // Also protected by cs_inventory
     std::vector<uint256> vBlockHashesToAnnounce;
@@ -885,7 +922,7 @@ public:
             }
         } else if (inv.type == MSG_DANDELION_TX) {
             if (setDandelionInventoryKnown.count(inv.hash)==0) {
-                vInventoryDandelionTxToSend.push_back(inv.hash);
+                mapInventoryDandelionTxToSend.emplace(inv.hash, GetTimeMicros());
             }
         } else if (inv.type == MSG_BLOCK) {
             vInventoryBlockToSend.push_back(inv.hash);
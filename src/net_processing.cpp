@@ -23,6 +23,7 @@
 #include <random.h>
 #include <reverse_iterator.h>
 #include <scheduler.h>
+#include <syncstats.h>
 #include <tinyformat.h>
 #include <txmempool.h>
 #include <ui_interface.h>
@@ -135,6 +136,7 @@ namespace {
         const CBlockIndex* pindex;                               //!< Optional.
         bool fValidatedHeaders;                                  //!< Whether this block has validated headers at the time of request.
         std::unique_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
+        int64_t nTimeRequested;                                  //!< When the block was requested (in microseconds).
     };
     std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight GUARDED_BY(cs_main);
 
@@ -147,6 +149,10 @@ namespace {
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads GUARDED_BY(cs_main) = 0;
 
+    /** Moving average of the size of requested blocks we received, in bytes, or 0 before the first. */
+    int64_t nAvgBlockSize GUARDED_BY(cs_main) = 0;
+    int nAvgBlockSizeSamples GUARDED_BY(cs_main) = 0;
+
     /** Number of outbound peers with m_chain_sync.m_protect. */
     int g_outbound_peers_with_protect_from_disconnect GUARDED_BY(cs_main) = 0;
 
@@ -222,6 +228,15 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Moving averages of the size (in bytes) and transfer time (in microseconds) of blocks we requested from this peer, or 0.
+    int64_t nBlockBytesAvg;
+    int64_t nBlockTimeAvg;
+    //! Number of blocks in the averages above, up to BLOCK_DOWNLOAD_MIN_SAMPLES.
+    int nBlockSamples;
+    //! When the last block we requested from this peer arrived (in microseconds), or 0.
+    int64_t nLastBlockReceived;
+    //! How many blocks we keep in flight from this peer, as last sized in SendMessages.
+    int nMaxBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -289,6 +304,11 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlockBytesAvg = 0;
+        nBlockTimeAvg = 0;
+        nBlockSamples = 0;
+        nLastBlockReceived = 0;
+        nMaxBlocksInFlight = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -386,7 +406,7 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     MarkBlockAsReceived(hash);
 
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(),
-            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr)});
+            {hash, pindex, pindex != nullptr, std::unique_ptr<PartiallyDownloadedBlock>(pit ? new PartiallyDownloadedBlock(&mempool) : nullptr), GetTimeMicros()});
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += it->fValidatedHeaders;
     if (state->nBlocksInFlight == 1) {
@@ -402,6 +422,35 @@ static bool MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const CBlock
     return true;
 }
 
+/** Smallest ping time measured to a peer, or 0 if none was yet. */
+static int64_t GetPeerRtt(const CNode* pnode)
+{
+    const int64_t nMinPing = pnode->nMinPingUsecTime;
+    return nMinPing == std::numeric_limits<int64_t>::max() ? 0 : nMinPing;
+}
+
+/** Moving average over nSamples samples, to which nSample is added. The first BLOCK_DOWNLOAD_MIN_SAMPLES are weighed equally. */
+static int64_t AddBlockDownloadSample(int64_t nAvg, int64_t nSample, int& nSamples)
+{
+    if (nSamples < BLOCK_DOWNLOAD_MIN_SAMPLES) {
+        nSamples++;
+        return nAvg + (nSample - nAvg) / nSamples;
+    }
+    return (7 * nAvg + nSample) / 8;
+}
+
+/** Account a requested block of nBytes, arriving at nNow, in the download rate of the peer it was requested from. */
+static void UpdateBlockDownloadRate(CNodeState* state, const QueuedBlock& queued, int64_t nBytes, int64_t nNow) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    const int64_t nElapsed = GetBlockTransferTime(queued.nTimeRequested, state->nLastBlockReceived, nNow, nBytes);
+    state->nLastBlockReceived = nNow;
+
+    int nSamples = state->nBlockSamples;
+    state->nBlockBytesAvg = AddBlockDownloadSample(state->nBlockBytesAvg, nBytes, nSamples);
+    state->nBlockTimeAvg = AddBlockDownloadSample(state->nBlockTimeAvg, nElapsed, state->nBlockSamples);
+    nAvgBlockSize = AddBlockDownloadSample(nAvgBlockSize, nBytes, nAvgBlockSizeSamples);
+}
+
 /** Check whether the last unknown block a peer advertised is not yet known. */
 static void ProcessBlockAvailability(NodeId nodeid) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
     CNodeState *state = State(nodeid);
@@ -509,6 +558,7 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
     if (count == 0)
         return;
 
+    CSyncStageTimer timer(SyncStage::FIND_NEXT_BLOCKS);
     vBlocks.reserve(vBlocks.size() + count);
     CNodeState *state = State(nodeid);
     assert(state != nullptr);
@@ -535,10 +585,10 @@ static void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vec
 
     std::vector<const CBlockIndex*> vToFetch;
     const CBlockIndex *pindexWalk = state->pindexLastCommonBlock;
-    // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
+    // Never fetch further than the best block we know the peer has, or more than the download window + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
-    int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
+    int nWindowEnd = state->pindexLastCommonBlock->nHeight + GetBlockDownloadWindow(nAvgBlockSize);
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
     while (pindexWalk->nHeight < nMaxHeight) {
@@ -656,6 +706,42 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
     LogPrint(BCLog::NET, "Cleared nodestate for peer=%d\n", nodeid);
 }
 
+int64_t GetBlockTransferTime(int64_t nRequested, int64_t nLastReceived, int64_t nNow, int64_t nBytes)
+{
+    // Peers answer requests in order, so the transfer of a block starts when the previous
+    // one arrived, or when it was requested if the peer had nothing left to send then. The
+    // round trip is not taken off the latter: what is left of a short wait could be next to
+    // nothing.
+    const int64_t nElapsed = nNow - std::max(nRequested, nLastReceived);
+    // Blocks that arrive in the same read of the socket would look instantaneous
+    return std::max<int64_t>({nElapsed, nBytes * 1000000 / MAX_BLOCK_DOWNLOAD_RATE, 1});
+}
+
+int GetMaxBlocksInFlight(int64_t nBytes, int64_t nMicros, int64_t nRttMicros, int64_t nBlockSize)
+{
+    if (nBytes <= 0 || nMicros <= 0 || nBlockSize <= 0)
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    const int64_t nTargetBlocks = nBytes * (nRttMicros + BLOCK_DOWNLOAD_TARGET_LATENCY) / nMicros / nBlockSize;
+    return std::max<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(nTargetBlocks, MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE));
+}
+
+int GetBlockDownloadWindow(int64_t nBlockSize)
+{
+    if (nBlockSize <= 0)
+        return BLOCK_DOWNLOAD_WINDOW;
+    return std::max<int64_t>(BLOCK_DOWNLOAD_WINDOW, std::min<int64_t>(BLOCK_DOWNLOAD_WINDOW_BYTES / nBlockSize, MAX_BLOCK_DOWNLOAD_WINDOW));
+}
+
+int64_t GetBlockStallingTimeout(int64_t nBytes, int64_t nMicros, int64_t nRttMicros, int64_t nInFlightBytes)
+{
+    int64_t nTimeout = 1000000 * BLOCK_STALLING_TIMEOUT;
+    if (nBytes > 0 && nMicros > 0) {
+        // Twice what the peer should take to deliver everything we asked it for
+        nTimeout = std::max(nTimeout, 2 * (nRttMicros + nInFlightBytes * nMicros / nBytes));
+    }
+    return std::min<int64_t>(nTimeout, 1000000 * BLOCK_STALLING_TIMEOUT_MAX);
+}
+
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     LOCK(cs_main);
     CNodeState *state = State(nodeid);
@@ -668,6 +754,8 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlockRate = state->nBlockSamples >= BLOCK_DOWNLOAD_MIN_SAMPLES ? state->nBlockBytesAvg * 1000000 / state->nBlockTimeAvg : 0;
+    stats.nMaxBlocksInFlight = state->nMaxBlocksInFlight;
     return true;
 }
 
@@ -854,6 +942,14 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
     scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckDandelionEmbargoes, this), DANDELION_EMBARGO_CHECK_INTERVAL * 1000);
+}
+
+void PeerLogicValidation::TransactionAddedToMempool(const CTransactionRef& ptx) {
+    // Stempool acceptance is signalled too; only the mempool ends an embargo
+    if (mempool.exists(ptx->GetHash()) && connman->removeDandelionEmbargo(ptx->GetHash())) {
+        LogPrint(BCLog::DANDELION, "Embargoed dandeliontx %s found in mempool; removing from embargo map\n", ptx->GetHash().ToString());
+    }
 }
 
 /**
@@ -904,7 +1000,7 @@ static bool fWitnessesPresentInMostRecentCompactBlock GUARDED_BY(cs_most_recent_
  * to compatible peers.
  */
 void PeerLogicValidation::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) {
-    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true);
+    std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock = std::make_shared<const CBlockHeaderAndShortTxIDs> (*pblock, true, &mempool);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
 
     LOCK(cs_main);
@@ -1082,11 +1178,22 @@ static void RelayTransaction(const CTransaction& tx, CConnman* connman)
     });
 }
     
+/** Look a transaction up in the stem pool, or in the mempool under it once it was fluffed. */
+static TxMempoolInfo StemPoolInfo(const uint256& hash)
+{
+    TxMempoolInfo txinfo = stempool.info(hash);
+    if (!txinfo.tx) {
+        txinfo = mempool.info(hash);
+    }
+    return txinfo;
+}
+
 static void RelayDandelionTransaction(const CTransaction& tx, CConnman* connman, CNode* pfrom)
 {
     FastRandomContext rng;
     if (rng.randrange(100)<DANDELION_FLUFF) {
         LogPrint(BCLog::DANDELION, "Dandelion fluff: %s\n", tx.GetHash().ToString());
+        connman->RecordDandelionFluff();
         CValidationState state;
         CTransactionRef ptx = stempool.get(tx.GetHash());
         bool fMissingInputs = false;
@@ -1104,34 +1211,6 @@ static void RelayDandelionTransaction(const CTransaction& tx, CConnman* connman,
     }
 }
 
-static void CheckDandelionEmbargoes(CConnman* connman)
-{
-    int64_t nCurrTime = GetTimeMicros();
-    for (auto iter=connman->mDandelionEmbargo.begin(); iter!=connman->mDandelionEmbargo.end();) {
-        if (mempool.exists(iter->first)) {
-            LogPrint(BCLog::DANDELION, "Embargoed dandeliontx %s found in mempool; removing from embargo map\n", iter->first.ToString());
-            iter = connman->mDandelionEmbargo.erase(iter);
-        } else if (iter->second < nCurrTime) {
-            LogPrint(BCLog::DANDELION, "dandeliontx %s embargo expired\n", iter->first.ToString());
-            CValidationState state;
-            CTransactionRef ptx = stempool.get(iter->first);
-            if (ptx)
-            {
-                bool fMissingInputs = false;
-                std::list<CTransactionRef> lRemovedTxn;
-                AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
-                LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: accepted %s (poolsz %u txn, %u kB)\n",
-                         iter->first.ToString(), mempool.size(), mempool.DynamicMemoryUsage() / 1000);
-                RelayTransaction(*ptx, connman);
-            }
-            iter = connman->mDandelionEmbargo.erase(iter);
-        } else {
-            iter++;
-        }
-    }
-}
-
-
 static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connman)
 {
     unsigned int nRelayNodes = fReachable ? 2 : 1; // limited relaying of addresses outside our network(s)
@@ -1348,7 +1427,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
             bool push = false;
             if (inv.type == MSG_DANDELION_TX || inv.type == MSG_DANDELION_WITNESS_TX) {
                 int nSendFlags = (inv.type == MSG_DANDELION_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
-                auto txinfo = stempool.info(inv.hash);
+                auto txinfo = StemPoolInfo(inv.hash);
                 uint256 dandelionServiceDiscoveryHash;
                 dandelionServiceDiscoveryHash.SetHex("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
                 if (txinfo.tx && !connman->isDandelionInbound(pfrom) && pfrom->setDandelionInventoryKnown.count(inv.hash)!=0) {
@@ -1363,7 +1442,7 @@ void static ProcessGetData(CNode* pfrom, const CChainParams& chainparams, CConnm
                 auto mi = mapRelay.find(inv.hash);
                 int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
                 if (!pfrom->fSupportsDandelion && !connman->isDandelionInbound(pfrom) && pfrom->setDandelionInventoryKnown.count(inv.hash)!=0) {
-                    auto txinfo = stempool.info(inv.hash);
+                    auto txinfo = StemPoolInfo(inv.hash);
                     if (txinfo.tx) {
                         connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txinfo.tx));
                         push = true;
@@ -1443,6 +1522,8 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
         return true;
     }
 
+    CSyncStageTimer timer(SyncStage::PROCESS_HEADERS, nCount);
+
     bool received_new_header = false;
     const CBlockIndex *pindexLast = nullptr;
     {
@@ -1678,11 +1759,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
     }
 
-    {
-        LOCK(cs_main);
-        CheckDandelionEmbargoes(connman);
-    }
-
     if (strCommand == NetMsgType::REJECT)
     {
         if (LogAcceptCategory(BCLog::NET)) {
@@ -2329,7 +2405,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         bool fMissingInputs = false;
         CValidationState state;
-        CValidationState dummyState; // Dummy state for Dandelion stempool
 
         pfrom->setAskFor.erase(inv.hash);
         mapAlreadyAskedFor.erase(inv.hash);
@@ -2338,12 +2413,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
 
         if (!AlreadyHave(inv) &&
             AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-            // Changes to mempool should also be made to Dandelion stempool
-            AcceptToMemoryPool(stempool, dummyState, ptx, nullptr, nullptr, false, 0);
-            if (connman->isTxDandelionEmbargoed(tx.GetHash())) {
-                LogPrint(BCLog::DANDELION, "Embargoed dandeliontx %s found in mempool; removing from embargo map\n", tx.GetHash().ToString());
-                connman->removeDandelionEmbargo(tx.GetHash());
-            }
             mempool.check(pcoinsTip.get());
             // Changes to mempool should also be made to Dandelion stempool
             stempool.check(pcoinsTip.get());
@@ -2379,13 +2448,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                     // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
                     // anyone relaying LegitTxX banned)
                     CValidationState stateDummy;
-                    CValidationState stateDummyDandelion;
 
                     if (setMisbehaving.count(fromPeer))
                         continue;
                     if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-                        // Changes to mempool should also be made to Dandelion stempool
-                        AcceptToMemoryPool(stempool, stateDummyDandelion, porphanTx, nullptr, nullptr, false, 0);
                         LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
                         RelayTransaction(orphanTx, connman);
                         for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
@@ -2870,6 +2936,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+        const int64_t nBlockBytes = vRecv.size();
         vRecv >> *pblock;
 
         LogPrint(BCLog::NET, "received block %s peer=%d\n", pblock->GetHash().ToString(), pfrom->GetId());
@@ -2878,6 +2945,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         const uint256 hash(pblock->GetHash());
         {
             LOCK(cs_main);
+            auto itInFlight = mapBlocksInFlight.find(hash);
+            if (itInFlight != mapBlocksInFlight.end() && itInFlight->second.first == pfrom->GetId()) {
+                UpdateBlockDownloadRate(State(pfrom->GetId()), *itInFlight->second.second, nBlockBytes, GetTimeMicros());
+            }
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
             forceProcessing |= MarkBlockAsReceived(hash);
@@ -3372,6 +3443,34 @@ void PeerLogicValidation::EvictExtraOutboundPeers(int64_t time_in_seconds)
     }
 }
 
+void PeerLogicValidation::CheckDandelionEmbargoes()
+{
+    const std::vector<uint256> vExpired = connman->popExpiredDandelionEmbargoes(GetTimeMicros());
+    if (vExpired.empty())
+        return;
+
+    LOCK(cs_main);
+    for (const uint256& hash : vExpired) {
+        if (mempool.exists(hash)) {
+            LogPrint(BCLog::DANDELION, "Embargoed dandeliontx %s found in mempool; removing from embargo map\n", hash.ToString());
+            continue;
+        }
+        LogPrint(BCLog::DANDELION, "dandeliontx %s embargo expired\n", hash.ToString());
+        connman->RecordDandelionEmbargoExpiry();
+        CValidationState state;
+        CTransactionRef ptx = stempool.get(hash);
+        if (ptx)
+        {
+            bool fMissingInputs = false;
+            std::list<CTransactionRef> lRemovedTxn;
+            AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */);
+            LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: accepted %s (poolsz %u txn, %u kB)\n",
+                     hash.ToString(), mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+            RelayTransaction(*ptx, connman);
+        }
+    }
+}
+
 void PeerLogicValidation::CheckForStaleTipAndEvictPeers(const Consensus::Params &consensusParams)
 {
     if (connman == nullptr) return;
@@ -3687,22 +3786,38 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
             }
             pto->vInventoryBlockToSend.clear();
             
-            // Add Dandelion transactions
-            for (const uint256& hash : pto->vInventoryDandelionTxToSend) {
-                pto->setDandelionInventoryKnown.insert(hash);
+            // Add Dandelion transactions, batched on their own trickle timer
+            bool fSendDandelionTrickle = pto->fWhitelisted;
+            if (pto->nNextDandelionInvSend < nNow) {
+                fSendDandelionTrickle = true;
+                pto->nNextDandelionInvSend = PoissonNextSend(nNow, DANDELION_INVENTORY_BROADCAST_INTERVAL);
+            }
+            if (fSendDandelionTrickle && !pto->mapInventoryDandelionTxToSend.empty()) {
                 uint256 dandelionServiceDiscoveryHash;
                 dandelionServiceDiscoveryHash.SetHex("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
-                if (!pto->fSupportsDandelion && hash!=dandelionServiceDiscoveryHash) {
-                    vInv.push_back(CInv(MSG_TX, hash));
-                } else {
-                    vInv.push_back(CInv(MSG_DANDELION_TX, hash));
-                }
-                if (vInv.size() == MAX_INV_SZ) {
-                    connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
-                    vInv.clear();
+                uint64_t nStemRelayed = 0;
+                int64_t nStemLatency = 0;
+                for (const auto& entry : pto->mapInventoryDandelionTxToSend) {
+                    const uint256& hash = entry.first;
+                    pto->setDandelionInventoryKnown.insert(hash);
+                    if (hash != dandelionServiceDiscoveryHash) {
+                        nStemRelayed++;
+                        nStemLatency += nNow - entry.second;
+                    }
+                    if (!pto->fSupportsDandelion && hash!=dandelionServiceDiscoveryHash) {
+                        vInv.push_back(CInv(MSG_TX, hash));
+                    } else {
+                        vInv.push_back(CInv(MSG_DANDELION_TX, hash));
+                    }
+                    if (vInv.size() == MAX_INV_SZ) {
+                        connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
+                        vInv.clear();
+                    }
                 }
+                pto->mapInventoryDandelionTxToSend.clear();
+                pto->nDandelionStemSent += nStemRelayed;
+                connman->RecordDandelionStemRelay(nStemRelayed, nStemLatency);
             }
-            pto->vInventoryDandelionTxToSend.clear();
 
             // Check whether periodic sends should happen
             bool fSendTrickle = pto->fWhitelisted;
@@ -3824,9 +3939,12 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         if (!vInv.empty())
             connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
 
+        // The download rate of the peer is only used once it averages enough blocks
+        const int64_t nRateBytes = state.nBlockSamples >= BLOCK_DOWNLOAD_MIN_SAMPLES ? state.nBlockBytesAvg : 0;
+
         // Detect whether we're stalling
         nNow = GetTimeMicros();
-        if (state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
+        if (state.nStallingSince && state.nStallingSince < nNow - GetBlockStallingTimeout(nRateBytes, state.nBlockTimeAvg, GetPeerRtt(pto), state.nBlocksInFlight * nAvgBlockSize)) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
@@ -3889,10 +4007,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto)
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        state.nMaxBlocksInFlight = GetMaxBlocksInFlight(nRateBytes, state.nBlockTimeAvg, GetPeerRtt(pto), nAvgBlockSize);
+        if (!pto->fClient && ((fFetch && !pto->m_limited_node) || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nMaxBlocksInFlight) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.nMaxBlocksInFlight - state.nBlocksInFlight, vToDownload, staller, consensusParams);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -43,6 +43,10 @@ public:
      * Overridden from CValidationInterface.
      */
     void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& pblock) override;
+    /**
+     * Overridden from CValidationInterface.
+     */
+    void TransactionAddedToMempool(const CTransactionRef& ptx) override;
 
     /** Initialize a peer by adding it to mapNodeState and pushing a message requesting its version */
     void InitializeNode(CNode* pnode) override;
@@ -69,6 +73,8 @@ public:
     void CheckForStaleTipAndEvictPeers(const Consensus::Params &consensusParams);
     /** If we have extra outbound peers, try to disconnect the one with the oldest block announcement */
     void EvictExtraOutboundPeers(int64_t time_in_seconds);
+    /** Fluff the Dandelion transactions whose embargo ended without them reaching the mempool */
+    void CheckDandelionEmbargoes();
 
 private:
     int64_t m_stale_tip_check_time; //! Next time to check for stale tip
@@ -82,9 +88,23 @@ struct CNodeStateStats {
     int nSyncHeight = -1;
     int nCommonHeight = -1;
     std::vector<int> vHeightInFlight;
+    int64_t nBlockRate = 0;
+    int nMaxBlocksInFlight = 0;
 };
 
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 
+/** Time (in microseconds) a block of nBytes requested at nRequested took to arrive at nNow, given that the
+ *  previous block from the same peer arrived at nLastReceived. Never less than MAX_BLOCK_DOWNLOAD_RATE allows. */
+int64_t GetBlockTransferTime(int64_t nRequested, int64_t nLastReceived, int64_t nNow, int64_t nBytes);
+/** Number of blocks to keep in flight from a peer that delivered nBytes of blocks in nMicros: enough to
+ *  cover its round trip time plus BLOCK_DOWNLOAD_TARGET_LATENCY at that rate, in blocks of nBlockSize bytes. */
+int GetMaxBlocksInFlight(int64_t nBytes, int64_t nMicros, int64_t nRttMicros, int64_t nBlockSize);
+/** Number of blocks past the last block we have in common with a peer that we fetch, for blocks of nBlockSize bytes. */
+int GetBlockDownloadWindow(int64_t nBlockSize);
+/** Time (in microseconds) that a peer with nInFlightBytes of blocks in flight may stall block download before
+ *  being disconnected, given that it delivered nBytes of blocks in nMicros. */
+int64_t GetBlockStallingTimeout(int64_t nBytes, int64_t nMicros, int64_t nRttMicros, int64_t nInFlightBytes);
+
 #endif // DIGIBYTE_NET_PROCESSING_H
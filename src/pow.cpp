@@ -8,10 +8,15 @@
 
 #include <arith_uint256.h>
 #include <chain.h>
+#include <crypto/scrypt.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <uint256.h>
+#include <utilstrencodings.h>
 #include <chainparams.h>
 
+#include <string.h>
+
 #include "util.h" //just for logs
 
 inline unsigned int PowLimit(const Consensus::Params& params)
@@ -192,25 +197,9 @@ unsigned int GetNextWorkRequiredV3(const CBlockIndex* pindexLast, const Consensu
 	return bnNew.GetCompact();
 }
 
-unsigned int GetNextWorkRequiredV4(const CBlockIndex* pindexLast, const Consensus::Params& params, int algo)
+/** Clamp the median time past span of a V4 averaging window. */
+static int64_t LimitActualTimespanV4(int64_t nActualTimespan, const Consensus::Params& params)
 {
-	// find first block in averaging interval
-	// Go back by what we want to be nAveragingInterval blocks per algo
-	const CBlockIndex* pindexFirst = pindexLast;
-	for (int i = 0; pindexFirst && i < NUM_ALGOS*params.nAveragingInterval; i++)
-	{
-		pindexFirst = pindexFirst->pprev;
-	}
-
-	const CBlockIndex* pindexPrevAlgo = GetLastBlockIndexForAlgo(pindexLast, params, algo);
-	if (pindexPrevAlgo == nullptr || pindexFirst == nullptr)
-	{
-		return InitialDifficulty(params, algo);
-	}
-
-	// Limit adjustment step
-	// Use medians to prevent time-warp attacks
-	int64_t nActualTimespan = pindexLast-> GetMedianTimePast() - pindexFirst->GetMedianTimePast();
 	nActualTimespan = params.nAveragingTargetTimespanV4 + (nActualTimespan - params.nAveragingTargetTimespanV4)/4;
 
 	if (nActualTimespan < params.nMinActualTimespanV4)
@@ -218,6 +207,12 @@ unsigned int GetNextWorkRequiredV4(const CBlockIndex* pindexLast, const Consensu
 	if (nActualTimespan > params.nMaxActualTimespanV4)
 		nActualTimespan = params.nMaxActualTimespanV4;
 
+	return nActualTimespan;
+}
+
+/** Retarget from the last block of an algo, given the clamped timespan of the window ending at pindexLast. */
+static unsigned int RetargetV4(const CBlockIndex* pindexLast, const CBlockIndex* pindexPrevAlgo, int64_t nActualTimespan, const Consensus::Params& params)
+{
 	//Global retarget
 	arith_uint256 bnNew;
 	bnNew.SetCompact(pindexPrevAlgo->nBits);
@@ -252,6 +247,104 @@ unsigned int GetNextWorkRequiredV4(const CBlockIndex* pindexLast, const Consensu
 	return bnNew.GetCompact();
 }
 
+unsigned int GetNextWorkRequiredV4(const CBlockIndex* pindexLast, const Consensus::Params& params, int algo)
+{
+	// find first block in averaging interval
+	// Go back by what we want to be nAveragingInterval blocks per algo
+	const CBlockIndex* pindexFirst = pindexLast;
+	for (int i = 0; pindexFirst && i < NUM_ALGOS*params.nAveragingInterval; i++)
+	{
+		pindexFirst = pindexFirst->pprev;
+	}
+
+	const CBlockIndex* pindexPrevAlgo = GetLastBlockIndexForAlgo(pindexLast, params, algo);
+	if (pindexPrevAlgo == nullptr || pindexFirst == nullptr)
+	{
+		return InitialDifficulty(params, algo);
+	}
+
+	// Limit adjustment step
+	// Use medians to prevent time-warp attacks
+	int64_t nActualTimespan = LimitActualTimespanV4(pindexLast->GetMedianTimePast() - pindexFirst->GetMedianTimePast(), params);
+
+	return RetargetV4(pindexLast, pindexPrevAlgo, nActualTimespan, params);
+}
+
+namespace {
+
+/**
+ * V4 retarget state on top of the tip of the active chain. All algos share
+ * the averaging window and its median time past span, so the next work of
+ * every algo is computed once, when the tip changes. GetBlockProof asks for
+ * every active algo on top of each new block, and header checks, block
+ * templates and RPCs ask again for the same tip.
+ */
+struct RetargetContext
+{
+	const CBlockIndex* pindexTip = nullptr;
+	uint256 hashTip;
+	const Consensus::Params* params = nullptr;
+	unsigned int nNextBits[NUM_ALGOS_IMPL] = {};
+};
+
+CCriticalSection cs_retarget;
+RetargetContext g_retarget GUARDED_BY(cs_retarget);
+
+/** First block of the V4 averaging window ending at pindexLast, found through the skip list, and the clamped span of the window. */
+const CBlockIndex* GetAveragingWindowV4(const CBlockIndex* pindexLast, const Consensus::Params& params, int64_t& nActualTimespan)
+{
+	const CBlockIndex* pindexFirst = pindexLast->GetAncestor(pindexLast->nHeight - NUM_ALGOS*params.nAveragingInterval);
+	if (pindexFirst != nullptr)
+		nActualTimespan = LimitActualTimespanV4(pindexLast->GetMedianTimePast() - pindexFirst->GetMedianTimePast(), params);
+	return pindexFirst;
+}
+
+/** GetNextWorkRequiredV4 given the window from GetAveragingWindowV4. */
+unsigned int GetNextWorkRequiredV4InWindow(const CBlockIndex* pindexLast, const CBlockIndex* pindexFirst, int64_t nActualTimespan, const Consensus::Params& params, int algo)
+{
+	const CBlockIndex* pindexPrevAlgo = GetLastBlockIndexForAlgo(pindexLast, params, algo);
+	if (pindexPrevAlgo == nullptr || pindexFirst == nullptr)
+		return InitialDifficulty(params, algo);
+	return RetargetV4(pindexLast, pindexPrevAlgo, nActualTimespan, params);
+}
+
+} // namespace
+
+void UpdateRetargetContext(const CBlockIndex* pindexTip, const Consensus::Params& params)
+{
+	RetargetContext ctx;
+	if (pindexTip != nullptr && pindexTip->phashBlock != nullptr && pindexTip->nHeight >= params.workComputationChangeTarget)
+	{
+		ctx.pindexTip = pindexTip;
+		ctx.hashTip = *pindexTip->phashBlock;
+		ctx.params = &params;
+		int64_t nActualTimespan = 0;
+		const CBlockIndex* pindexFirst = GetAveragingWindowV4(pindexTip, params, nActualTimespan);
+		for (int algo = 0; algo < NUM_ALGOS_IMPL; algo++)
+			ctx.nNextBits[algo] = GetNextWorkRequiredV4InWindow(pindexTip, pindexFirst, nActualTimespan, params, algo);
+	}
+	LOCK(cs_retarget);
+	g_retarget = ctx;
+}
+
+unsigned int GetNextWorkRequiredV4Cached(const CBlockIndex* pindexLast, const Consensus::Params& params, int algo)
+{
+	if (algo < 0 || algo >= NUM_ALGOS_IMPL)
+		return GetNextWorkRequiredV4(pindexLast, params, algo);
+
+	// The hash tells the tip apart from a later block index at the same address
+	if (pindexLast->phashBlock != nullptr)
+	{
+		LOCK(cs_retarget);
+		if (g_retarget.pindexTip == pindexLast && g_retarget.params == &params && g_retarget.hashTip == *pindexLast->phashBlock)
+			return g_retarget.nNextBits[algo];
+	}
+
+	int64_t nActualTimespan = 0;
+	const CBlockIndex* pindexFirst = GetAveragingWindowV4(pindexLast, params, nActualTimespan);
+	return GetNextWorkRequiredV4InWindow(pindexLast, pindexFirst, nActualTimespan, params, algo);
+}
+
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params& params, int algo)
 {
     // Genesis block
@@ -274,7 +367,7 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
 	} else if(pindexLast->nHeight < params.workComputationChangeTarget)
 		return GetNextWorkRequiredV3(pindexLast, params, algo);
 	else
-		return GetNextWorkRequiredV4(pindexLast, params, algo);
+		return GetNextWorkRequiredV4Cached(pindexLast, params, algo);
 }
 
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params& params)
@@ -323,15 +416,24 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
 
 const CBlockIndex* GetLastBlockIndexForAlgo(const CBlockIndex* pindex, const Consensus::Params& params, int algo)
 {
-    for (; pindex; pindex = pindex->pprev)
+    const bool fKnownAlgo = GetAlgoSlot(algo) >= 0;
+    while (pindex)
     {
         if (pindex->GetAlgo() != algo)
+        {
+            // jump over blocks of other algos when the per-algo links are built
+            if (fKnownAlgo && pindex->HasAlgoLinks())
+                pindex = pindex->GetLastAlgoBlock(algo);
+            else
+                pindex = pindex->pprev;
             continue;
+        }
         // ignore special min-difficulty testnet blocks
         if (params.fPowAllowMinDifficultyBlocks &&
             pindex->pprev &&
             pindex->nTime > pindex->pprev->nTime + params.nTargetSpacing*2)
         {
+            pindex = pindex->pprev;
             continue;
         }
         return pindex;
@@ -343,3 +445,28 @@ uint256 GetPoWAlgoHash(const CBlockHeader& block)
 {
     return block.GetPoWAlgoHash(Params().GetConsensus());
 }
+
+void GetPoWAlgoHashes(const std::vector<const CBlockHeader*>& headers, std::vector<uint256>& hashes, const Consensus::Params& params)
+{
+    hashes.resize(headers.size());
+
+    // Collect the 80 byte scrypt inputs so that they can be hashed together
+    std::vector<size_t> scryptIndexes;
+    std::vector<char> scryptInput;
+    for (size_t i = 0; i < headers.size(); i++) {
+        const CBlockHeader& header = *headers[i];
+        if (header.GetAlgo() == ALGO_SCRYPT) {
+            scryptIndexes.push_back(i);
+            scryptInput.insert(scryptInput.end(), BEGIN(header.nVersion), END(header.nNonce));
+        } else {
+            hashes[i] = header.GetPoWAlgoHash(params);
+        }
+    }
+    if (scryptIndexes.empty())
+        return;
+
+    std::vector<char> scryptOutput(32 * scryptIndexes.size());
+    scrypt_1024_1_1_256_multi(scryptInput.data(), scryptOutput.data(), scryptIndexes.size());
+    for (size_t n = 0; n < scryptIndexes.size(); n++)
+        memcpy(hashes[scryptIndexes[n]].begin(), &scryptOutput[32 * n], 32);
+}
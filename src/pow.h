@@ -10,6 +10,7 @@
 #include <consensus/params.h>
 
 #include <stdint.h>
+#include <vector>
 
 class CBlockHeader;
 class CBlockIndex;
@@ -21,11 +22,19 @@ unsigned int GetNextWorkRequiredv1(const CBlockIndex* pindexLast, const CBlockHe
 unsigned int GetNextWorkRequiredv2(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&, int algo);
 unsigned int GetNextWorkRequiredv3(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&, int algo);
 unsigned int GetNextWorkRequiredv4(const CBlockIndex* pindexLast, const CBlockHeader *pblock, const Consensus::Params&, int algo);
+/** Next work under the V4 rules, walking back over the whole averaging window. */
+unsigned int GetNextWorkRequiredV4(const CBlockIndex* pindexLast, const Consensus::Params&, int algo);
+/** Same as GetNextWorkRequiredV4, answered from the retarget context if pindexLast is the tip it was last updated to. */
+unsigned int GetNextWorkRequiredV4Cached(const CBlockIndex* pindexLast, const Consensus::Params&, int algo);
+/** Compute the next work of every algo on top of a new active chain tip, for GetNextWorkRequiredV4Cached. Called with cs_main held whenever the tip changes. */
+void UpdateRetargetContext(const CBlockIndex* pindexTip, const Consensus::Params&);
 unsigned int CalculateNextWorkRequired(const CBlockIndex* pindexLast, int64_t nFirstBlockTime, const Consensus::Params&);
 
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
 const CBlockIndex* GetLastBlockIndexForAlgo(const CBlockIndex* pindex, const Consensus::Params&, int algo);
 uint256 GetPoWAlgoHash(const CBlockHeader& block);
+/** Compute the PoW hash of several headers at once, hashing scrypt headers side by side where supported. */
+void GetPoWAlgoHashes(const std::vector<const CBlockHeader*>& headers, std::vector<uint256>& hashes, const Consensus::Params&);
 
 #endif // DIGIBYTE_POW_H
@@ -11,7 +11,9 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
+#include <checkqueue.h>
 #include <coins.h>
+#include <coinstats.h>
 #include <consensus/validation.h>
 #include <validation.h>
 #include <core_io.h>
@@ -25,6 +27,7 @@
 #include <script/descriptor.h>
 #include <streams.h>
 #include <sync.h>
+#include <syncstats.h>
 #include <txdb.h>
 #include <txmempool.h>
 #include <util.h>
@@ -77,7 +80,12 @@ double GetDifficulty(const CChain& chain, const CBlockIndex* blockindex, int alg
     }
     else
         nBits = blockindex->nBits;
- 
+
+    return GetDifficultyFromBits(nBits);
+}
+
+double GetDifficultyFromBits(unsigned int nBits)
+{
     int nShift = (nBits >> 24) & 0xff;
     double dDiff =
         (double)0x0000ffff / (double)(nBits & 0x00ffffff);
@@ -877,7 +885,73 @@ struct CCoinsStats
     CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
 };
 
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+//! Number of parts the coin database is split into for gettxoutsetinfo and scantxoutset
+static const size_t UTXO_SCAN_SHARDS = 256;
+
+/** Closure running the work on one shard of a UTXO set scan. */
+class CUTXOScanCheck
+{
+private:
+    const std::function<bool(size_t)>* m_work;
+    size_t m_shard;
+
+public:
+    CUTXOScanCheck() : m_work(nullptr), m_shard(0) {}
+    CUTXOScanCheck(const std::function<bool(size_t)>& work, size_t shard) : m_work(&work), m_shard(shard) {}
+
+    bool operator()() { return (*m_work)(m_shard); }
+
+    void swap(CUTXOScanCheck& check)
+    {
+        std::swap(m_work, check.m_work);
+        std::swap(m_shard, check.m_shard);
+    }
+};
+
+//! Shards are large, so hand them out one at a time
+static CCheckQueue<CUTXOScanCheck> utxoscanqueue(1);
+
+void ThreadUTXOScan()
+{
+    RenameThread("digibyte-utxoscan");
+    utxoscanqueue.Thread();
+}
+
+/**
+ * Run work(shard) for shards 0..nShards-1 on the UTXO scan threads, and
+ * consume(shard) on the calling thread for each shard in order. Shards are
+ * queued a round of two per thread at a time; the calling thread consumes a
+ * round while the threads work on the next one, and then joins them. This
+ * bounds the memory taken by results waiting to be consumed, and concurrent
+ * scans share the threads by taking turns. Stops once work returns false,
+ * and returns whether all shards were consumed.
+ */
+static bool ForEachShard(size_t nShards, const std::function<bool(size_t)>& work, const std::function<void(size_t)>& consume)
+{
+    const size_t nRound = 2 * std::max(nScriptCheckThreads, 1);
+    size_t nDone = 0;
+    size_t nConsumed = 0;
+    while (nConsumed < nShards) {
+        const size_t nEnd = std::min(nDone + nRound, nShards);
+        {
+            CCheckQueueControl<CUTXOScanCheck> control(&utxoscanqueue);
+            std::vector<CUTXOScanCheck> vChecks;
+            for (size_t shard = nDone; shard < nEnd; shard++)
+                vChecks.emplace_back(work, shard);
+            control.Add(vChecks);
+            for (; nConsumed < nDone; nConsumed++)
+                consume(nConsumed);
+            if (!control.Wait())
+                return false;
+        }
+        nDone = nEnd;
+        boost::this_thread::interruption_point();
+    }
+    return true;
+}
+
+template <typename Stream>
+static void ApplyStats(CCoinsStats &stats, Stream& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
 {
     assert(!outputs.empty());
     ss << hash;
@@ -895,23 +969,12 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
     ss << VARINT(0u);
 }
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+//! Calculate statistics about the unspent transaction output set of one cursor, serializing what is hashed into ss
+static bool GetUTXOStats(CCoinsViewCursor* pcursor, CCoinsStats &stats, CDataStream& ss)
 {
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
-
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
     uint256 prevkey;
     std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
         COutPoint key;
         Coin coin;
         if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
@@ -929,6 +992,44 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
     if (!outputs.empty()) {
         ApplyStats(stats, ss, prevkey, outputs);
     }
+    return true;
+}
+
+//! Calculate statistics about the unspent transaction output set
+static bool GetUTXOStats(CCoinsViewDB *view, CCoinsStats &stats)
+{
+    // Shards are read and serialized in parallel, and hashed in order, which
+    // gives the same hash as serializing the whole set on one thread.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        cursors = view->Cursors(UTXO_SCAN_SHARDS);
+    }
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    stats.hashBlock = cursors[0]->GetBestBlock();
+    {
+        LOCK(cs_main);
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+    ss << stats.hashBlock;
+    std::vector<CCoinsStats> vShardStats(cursors.size());
+    std::vector<CDataStream> vShardData(cursors.size(), CDataStream(SER_GETHASH, PROTOCOL_VERSION));
+    auto work = [&](size_t shard) {
+        return GetUTXOStats(cursors[shard].get(), vShardStats[shard], vShardData[shard]);
+    };
+    auto consume = [&](size_t shard) {
+        ss.write(vShardData[shard].data(), vShardData[shard].size());
+        vShardData[shard] = CDataStream(SER_GETHASH, PROTOCOL_VERSION);
+        cursors[shard].reset();
+        stats.nTransactions += vShardStats[shard].nTransactions;
+        stats.nTransactionOutputs += vShardStats[shard].nTransactionOutputs;
+        stats.nBogoSize += vShardStats[shard].nBogoSize;
+        stats.nTotalAmount += vShardStats[shard].nTotalAmount;
+    };
+    if (!ForEachShard(cursors.size(), work, consume))
+        return false;
     stats.hashSerialized = ss.GetHash();
     stats.nDiskSize = view->EstimateSize();
     return true;
@@ -1009,7 +1110,6 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
     if (GetUTXOStats(pcoinsdbview.get(), stats)) {
         ret.pushKV("height", (int64_t)stats.nHeight);
         ret.pushKV("bestblock", stats.hashBlock.GetHex());
@@ -1025,6 +1125,48 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
     return ret;
 }
 
+static UniValue gettxoutsetcommitment(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "gettxoutsetcommitment\n"
+            "\nReturns the rolling commitment to the unspent transaction output set.\n"
+            "It is updated as blocks are connected and disconnected, so unlike gettxoutsetinfo\n"
+            "this call does not read the whole set. Requires -utxosetcommitment.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"height\":n,     (numeric) The current block height (index)\n"
+            "  \"bestblock\": \"hex\",   (string) The hash of the block at the tip of the chain\n"
+            "  \"txouts\": n,            (numeric) The number of unspent transaction outputs\n"
+            "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
+            "  \"muhash\": \"hash\",      (string) The MuHash3072 of the set, independent of the order of its outputs\n"
+            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gettxoutsetcommitment", "")
+            + HelpExampleRpc("gettxoutsetcommitment", "")
+        );
+
+    LOCK(cs_main);
+
+    if (!gArgs.GetBoolArg("-utxosetcommitment", DEFAULT_UTXO_SET_COMMITMENT)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "The UTXO set commitment is not maintained. Restart with -utxosetcommitment to enable it");
+    }
+    CUTXOSetStats stats;
+    if (!GetUTXOSetStats(stats)) {
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "UTXO set commitment is not loaded");
+    }
+    const CBlockIndex* pindex = LookupBlockIndex(stats.hashBlock);
+    UniValue ret(UniValue::VOBJ);
+    ret.pushKV("height", pindex ? pindex->nHeight : -1);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    ret.pushKV("muhash", stats.GetMuHash().GetHex());
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    return ret;
+}
+
 UniValue gettxout(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
@@ -1465,6 +1607,75 @@ static UniValue getmempoolinfo(const JSONRPCRequest& request)
     return mempoolInfoToJSON();
 }
 
+static UniValue getsyncstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getsyncstats ( reset )\n"
+            "\nReturns how long the stages of header and block sync take.\n"
+            "Percentiles are taken over the last " + std::to_string(SYNC_STATS_WINDOW) + " durations of each stage, all times are in microseconds.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"headers\": xxxxx,            (numeric) The height of the best known header\n"
+            "  \"blocks\": xxxxx,             (numeric) The height of the active chain\n"
+            "  \"stages\": {\n"
+            "    \"stage\": {                 (string) process_headers, accept_block_header, connect_block or find_next_blocks\n"
+            "      \"count\": xxxxx,          (numeric) Durations recorded\n"
+            "      \"items\": xxxxx,          (numeric) Headers or blocks handled\n"
+            "      \"total\": xxxxx,          (numeric) Time spent in the stage\n"
+            "      \"window\": xxxxx,         (numeric) Durations the percentiles are taken over\n"
+            "      \"p50\": xxxxx,            (numeric) Median duration\n"
+            "      \"p90\": xxxxx,            (numeric) 90th percentile duration\n"
+            "      \"p99\": xxxxx,            (numeric) 99th percentile duration\n"
+            "      \"max\": xxxxx             (numeric) Longest duration\n"
+            "    },\n"
+            "    ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getsyncstats", "")
+            + HelpExampleRpc("getsyncstats", "true")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        ret.pushKV("headers", pindexBestHeader ? pindexBestHeader->nHeight : -1);
+        ret.pushKV("blocks", chainActive.Height());
+    }
+
+    // Reading and clearing under one lock, so that no duration recorded in
+    // between is lost
+    std::vector<CSyncStageStats> vStats;
+    if (!request.params[0].isNull() && request.params[0].get_bool()) {
+        vStats = g_sync_stats.GetAndReset();
+    } else {
+        for (int i = 0; i < NUM_SYNC_STAGES; i++)
+            vStats.push_back(g_sync_stats.Get(static_cast<SyncStage>(i)));
+    }
+
+    UniValue stages(UniValue::VOBJ);
+    for (int i = 0; i < NUM_SYNC_STAGES; i++) {
+        const SyncStage stage = static_cast<SyncStage>(i);
+        const CSyncStageStats& stats = vStats[i];
+        UniValue obj(UniValue::VOBJ);
+        obj.pushKV("count", stats.nCount);
+        obj.pushKV("items", stats.nItems);
+        obj.pushKV("total", stats.nTotal);
+        obj.pushKV("window", (uint64_t)stats.nWindow);
+        obj.pushKV("p50", stats.nMedian);
+        obj.pushKV("p90", stats.nPercentile90);
+        obj.pushKV("p99", stats.nPercentile99);
+        obj.pushKV("max", stats.nMax);
+        stages.pushKV(SyncStageName(stage), obj);
+    }
+    ret.pushKV("stages", stages);
+
+    return ret;
+}
+
 static UniValue preciousblock(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -1999,31 +2210,23 @@ static UniValue savemempool(const JSONRPCRequest& request)
 }
 
 //! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
-    scan_progress = 0;
+bool FindScriptPubKey(const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
     count = 0;
     while (cursor->Valid()) {
         COutPoint key;
         Coin coin;
         if (!cursor->GetKey(key) || !cursor->GetValue(coin)) return false;
         if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
             if (should_abort) {
                 // allow to abort the scan via the abort reference
                 return false;
             }
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hash.begin() + *(key.hash.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
-        }
         if (needles.count(coin.out.scriptPubKey)) {
             out_results.emplace(key, coin);
         }
         cursor->Next();
     }
-    scan_progress = 100;
     return true;
 }
 
@@ -2174,14 +2377,27 @@ UniValue scantxoutset(const JSONRPCRequest& request)
         g_should_abort_scan = false;
         g_scan_progress = 0;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
+            cursors = pcoinsdbview->Cursors(UTXO_SCAN_SHARDS);
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
+        // Shards are scanned in parallel and merged in order, so that an
+        // aborted scan reports the matches of a prefix of the set
+        std::vector<int64_t> vShardCount(cursors.size(), 0);
+        std::vector<std::map<COutPoint, Coin>> vShardCoins(cursors.size());
+        auto work = [&](size_t shard) {
+            return FindScriptPubKey(g_should_abort_scan, vShardCount[shard], cursors[shard].get(), needles, vShardCoins[shard]);
+        };
+        auto consume = [&](size_t shard) {
+            count += vShardCount[shard];
+            coins.insert(vShardCoins[shard].begin(), vShardCoins[shard].end());
+            vShardCoins[shard].clear();
+            cursors[shard].reset();
+            g_scan_progress = (int)((shard + 1) * 100 / cursors.size());
+        };
+        bool res = ForEachShard(cursors.size(), work, consume);
         result.pushKV("success", res);
         result.pushKV("searched_items", count);
 
@@ -2227,8 +2443,10 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getsyncstats",           &getsyncstats,           {"reset"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetcommitment",  &gettxoutsetcommitment,  {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
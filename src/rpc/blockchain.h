@@ -25,6 +25,9 @@ static constexpr int NUM_GETBLOCKSTATS_PERCENTILES = 5;
  */
 double GetDifficulty(const CBlockIndex* blockindex = nullptr, int algo = 2);
 
+/** Get the difficulty of a compact target, as a multiple of the main net minimum difficulty. */
+double GetDifficultyFromBits(unsigned int nBits);
+
 /** Callback for when block tip changed. */
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 
@@ -40,6 +43,9 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** Run a thread that works on the shards of gettxoutsetinfo and scantxoutset. */
+void ThreadUTXOScan();
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -20,6 +20,7 @@
 #include <rpc/mining.h>
 #include <rpc/server.h>
 #include <shutdown.h>
+#include <timedata.h>
 #include <txmempool.h>
 #include <util.h>
 #include <utilstrencodings.h>
@@ -202,6 +203,7 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"currentblockweight\": nnn, (numeric) The last block weight\n"
             "  \"currentblocktx\": nnn,     (numeric) The last block transaction\n"
             "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
+            "  \"next_difficulties\": {...}  (object) The difficulty required of the next block, per active algo\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
@@ -229,6 +231,18 @@ static UniValue getmininginfo(const JSONRPCRequest& request)
             obj.pushKV(key, (double)GetDifficulty(NULL, algo));
         }
     }
+    UniValue next_difficulties(UniValue::VOBJ);
+    CBlockHeader nextHeader;
+    nextHeader.nTime = GetAdjustedTime();
+    for (int algo = 0; algo < NUM_ALGOS_IMPL; algo++)
+    {
+        if (IsAlgoActive(chainActive.Tip(), Params().GetConsensus(), algo))
+        {
+            unsigned int nBits = GetNextWorkRequired(chainActive.Tip(), &nextHeader, Params().GetConsensus(), algo);
+            next_difficulties.pushKV(GetAlgoName(algo), GetDifficultyFromBits(nBits));
+        }
+    }
+    obj.pushKV("next_difficulties",  next_difficulties);
     obj.pushKV("errors",           GetWarnings("statusbar"));
     //obj.push_back(Pair("networkhashps",    getnetworkhashps(request)));
     obj.pushKV("pooledtx",         (uint64_t)mempool.size());
@@ -525,14 +539,16 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    // Templates handed out per algo. They all share the transaction selection of
+    // pblocktemplate and only differ in the algo dependent header fields, so
+    // miners of different algos don't keep rebuilding each other's template.
+    static std::unique_ptr<CBlockTemplate> algoTemplates[NUM_ALGOS_IMPL];
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
-    static int lastAlgo;
     if (pindexPrev != chainActive.Tip() ||
         (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
-        fLastTemplateSupportsSegwit != fSupportsSegwit ||
-        algo != lastAlgo)
+        fLastTemplateSupportsSegwit != fSupportsSegwit)
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
         pindexPrev = nullptr;
@@ -542,7 +558,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
         CBlockIndex* pindexPrevNew = chainActive.Tip();
         nStart = GetTime();
         fLastTemplateSupportsSegwit = fSupportsSegwit;
-        lastAlgo = algo;
+        for (std::unique_ptr<CBlockTemplate>& palgotemplate : algoTemplates)
+            palgotemplate.reset();
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
@@ -554,8 +571,22 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
         pindexPrev = pindexPrevNew;
     }
     assert(pindexPrev);
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
     const Consensus::Params& consensusParams = Params().GetConsensus();
+    std::unique_ptr<CBlockTemplate>& palgotemplate = algoTemplates[algo];
+    if (!palgotemplate)
+    {
+        std::unique_ptr<CBlockTemplate> pnewtemplate(new CBlockTemplate(*pblocktemplate));
+        if (pnewtemplate->block.GetAlgo() != algo)
+        {
+            // CreateNewBlock only checked the block with the header fields of its own algo
+            UpdateAlgo(&pnewtemplate->block, Params(), pindexPrev, algo);
+            CValidationState state;
+            if (!TestBlockValidity(state, Params(), pnewtemplate->block, pindexPrev, false, false))
+                throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
+        }
+        palgotemplate = std::move(pnewtemplate);
+    }
+    CBlock* pblock = &palgotemplate->block; // pointer for convenience
 
     // Update nTime
     UpdateTime(pblock, consensusParams, pindexPrev, algo);
@@ -592,8 +623,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
         entry.pushKV("depends", deps);
 
         int index_in_template = i - 1;
-        entry.pushKV("fee", pblocktemplate->vTxFees[index_in_template]);
-        int64_t nTxSigOps = pblocktemplate->vTxSigOpsCost[index_in_template];
+        entry.pushKV("fee", palgotemplate->vTxFees[index_in_template]);
+        int64_t nTxSigOps = palgotemplate->vTxSigOpsCost[index_in_template];
         if (fPreSegWit) {
             assert(nTxSigOps % WITNESS_SCALE_FACTOR == 0);
             nTxSigOps /= WITNESS_SCALE_FACTOR;
@@ -700,8 +731,8 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
     if (algo == ALGO_ODO)
         result.pushKV("odokey", (int64_t)OdoKey(consensusParams, pblock->GetBlockTime()));
 
-    if (!pblocktemplate->vchCoinbaseCommitment.empty() && fSupportsSegwit) {
-        result.pushKV("default_witness_commitment", HexStr(pblocktemplate->vchCoinbaseCommitment.begin(), pblocktemplate->vchCoinbaseCommitment.end()));
+    if (!palgotemplate->vchCoinbaseCommitment.empty() && fSupportsSegwit) {
+        result.pushKV("default_witness_commitment", HexStr(palgotemplate->vchCoinbaseCommitment.begin(), palgotemplate->vchCoinbaseCommitment.end()));
     }
 
     return result;
@@ -9,6 +9,7 @@
 #include <core_io.h>
 #include <crypto/ripemd160.h>
 #include <key_io.h>
+#include <memusage.h>
 #include <validation.h>
 #include <httpserver.h>
 #include <net.h>
@@ -291,6 +292,16 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCBlockIndexMemoryInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("entries", uint64_t(mapBlockIndex.size()));
+    obj.pushKV("arena", uint64_t(blockIndexArena.DynamicMemoryUsage()));
+    obj.pushKV("map", uint64_t(memusage::DynamicUsage(mapBlockIndex)));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -332,6 +343,11 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the block index\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block index entries\n"
+            "    \"arena\": xxxxx,         (numeric) Number of bytes used by the entries\n"
+            "    \"map\": xxxxx,           (numeric) Number of bytes used by the hash index into them\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -345,6 +361,7 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("blockindex", RPCBlockIndexMemoryInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
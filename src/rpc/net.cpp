@@ -102,7 +102,11 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"blockrate\": n,            (numeric) The measured rate at which this peer delivers requested blocks, in bytes per second\n"
+            "    \"maxinflight\": n,          (numeric) The number of blocks we keep in flight from this peer\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
+            "    \"dandelion\": true|false,   (boolean) Whether the peer supports Dandelion transaction relay\n"
+            "    \"dandelion_stem_sent\": n,  (numeric) The number of Dandelion stem transactions announced to this peer\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
             "       ...\n"
@@ -168,8 +172,12 @@ static UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.pushKV("inflight", heights);
+            obj.pushKV("blockrate", statestats.nBlockRate);
+            obj.pushKV("maxinflight", statestats.nMaxBlocksInFlight);
         }
         obj.pushKV("whitelisted", stats.fWhitelisted);
+        obj.pushKV("dandelion", stats.fSupportsDandelion);
+        obj.pushKV("dandelion_stem_sent", stats.nDandelionStemSent);
 
         UniValue sendPerMsgCmd(UniValue::VOBJ);
         for (const mapMsgCmdSize::value_type &i : stats.mapSendBytesPerMsgCmd) {
@@ -450,6 +458,12 @@ static UniValue getnetworkinfo(const JSONRPCRequest& request)
             "  }\n"
             "  ,...\n"
             "  ]\n"
+            "  \"dandelion\": {                        (json object) Dandelion transaction relay totals\n"
+            "    \"stem_relayed\": n,                  (numeric) stem transactions announced to Dandelion destinations\n"
+            "    \"stem_latency\": n,                  (numeric) average time (in seconds) a stem transaction was queued before being announced\n"
+            "    \"fluffed\": n,                       (numeric) transactions that entered the fluff phase on receipt\n"
+            "    \"embargo_expired\": n                (numeric) transactions fluffed because their embargo ended\n"
+            "  }\n"
             "  \"warnings\": \"...\"                    (string) any network and blockchain warnings\n"
             "}\n"
             "\nExamples:\n"
@@ -486,6 +500,16 @@ static UniValue getnetworkinfo(const JSONRPCRequest& request)
         }
     }
     obj.pushKV("localaddresses", localAddresses);
+    if (g_connman) {
+        CDandelionStats dandelion_stats;
+        g_connman->GetDandelionStats(dandelion_stats);
+        UniValue dandelion(UniValue::VOBJ);
+        dandelion.pushKV("stem_relayed", dandelion_stats.nStemRelayed);
+        dandelion.pushKV("stem_latency", dandelion_stats.nStemRelayed ? 0.000001 * dandelion_stats.nStemLatencyMicros / dandelion_stats.nStemRelayed : 0.0);
+        dandelion.pushKV("fluffed", dandelion_stats.nFluffed);
+        dandelion.pushKV("embargo_expired", dandelion_stats.nEmbargoExpired);
+        obj.pushKV("dandelion", dandelion);
+    }
     obj.pushKV("warnings",       GetWarnings("statusbar"));
     return obj;
 }
@@ -0,0 +1,186 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIGIBYTE_SUPPORT_ALLOCATORS_POOL_H
+#define DIGIBYTE_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <assert.h>
+#include <cstddef>
+#include <list>
+#include <new>
+
+/**
+ * Memory resource for node based containers such as the UTXO cache's
+ * std::unordered_map, which otherwise make one malloc call per entry.
+ *
+ * Allocations of up to MAX_BLOCK_SIZE_BYTES are carved out of large chunks,
+ * in multiples of ALIGN_BYTES, so that neighbouring entries share cache lines
+ * and no per-allocation malloc overhead is paid. Freed blocks go into a free
+ * list per size and are handed out again for allocations of the same size.
+ * Larger allocations, like the bucket array of a big map, go to operator new.
+ *
+ * Chunks are only given back when the resource is destroyed, so a container
+ * that shrinks for good should be recreated together with its resource.
+ * Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+    static_assert(ALIGN_BYTES >= sizeof(void*), "free blocks must be able to hold a pointer");
+    static_assert(ALIGN_BYTES <= alignof(std::max_align_t), "chunks from operator new are only aligned to max_align_t");
+
+    /** In place of a freed block, links it to the next free block of the same size. */
+    struct ListNode {
+        ListNode* m_next;
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+
+    const std::size_t m_chunk_size_bytes;
+    std::list<void*> m_allocated_chunks;
+    //! Free lists, indexed by block size in units of ALIGN_BYTES
+    std::array<ListNode*, MAX_BLOCK_SIZE_BYTES / ALIGN_BYTES + 1> m_free_lists;
+    //! Part of the last chunk that was not handed out yet
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ALIGN_BYTES - 1) / ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void AddToFreeList(void* p, std::size_t num_alignments)
+    {
+        m_free_lists[num_alignments] = new (p) ListNode(m_free_lists[num_alignments]);
+    }
+
+    void AllocateChunk()
+    {
+        // The rest of the current chunk is too small for the allocation at
+        // hand, but may fit later ones of its size
+        const std::size_t remaining = m_available_memory_end - m_available_memory_it;
+        if (remaining > 0) {
+            AddToFreeList(m_available_memory_it, remaining / ALIGN_BYTES);
+        }
+        void* storage = ::operator new(m_chunk_size_bytes);
+        m_available_memory_it = static_cast<char*>(storage);
+        m_available_memory_end = m_available_memory_it + m_chunk_size_bytes;
+        m_allocated_chunks.push_back(storage);
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes = 256 * 1024)
+        : m_chunk_size_bytes(chunk_size_bytes / ALIGN_BYTES * ALIGN_BYTES), m_available_memory_it(nullptr), m_available_memory_end(nullptr)
+    {
+        assert(m_chunk_size_bytes >= NumElemAlignBytes(MAX_BLOCK_SIZE_BYTES) * ALIGN_BYTES);
+        m_free_lists.fill(nullptr);
+    }
+
+    ~PoolResource()
+    {
+        for (void* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        if (m_free_lists[num_alignments] != nullptr) {
+            ListNode* node = m_free_lists[num_alignments];
+            m_free_lists[num_alignments] = node->m_next;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ALIGN_BYTES;
+        if (round_bytes > static_cast<std::size_t>(m_available_memory_end - m_available_memory_it)) {
+            AllocateChunk();
+        }
+        void* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        AddToFreeList(p, NumElemAlignBytes(bytes));
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+/**
+ * Allocator that serves a container from a PoolResource, which must outlive
+ * it. A default constructed allocator has no resource and uses operator new.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(void*)>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() noexcept : m_resource(nullptr) {}
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.resource()) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (m_resource == nullptr) {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (m_resource == nullptr) {
+            ::operator delete(p);
+            return;
+        }
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+private:
+    ResourceType* m_resource;
+};
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator==(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return a.resource() == b.resource();
+}
+
+template <class T1, class T2, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+bool operator!=(const PoolAllocator<T1, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const PoolAllocator<T2, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b) noexcept
+{
+    return !(a == b);
+}
+
+#endif // DIGIBYTE_SUPPORT_ALLOCATORS_POOL_H
@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <syncstats.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <utility>
+
+CSyncStats g_sync_stats;
+
+const char* SyncStageName(SyncStage stage)
+{
+    switch (stage) {
+    case SyncStage::PROCESS_HEADERS: return "process_headers";
+    case SyncStage::ACCEPT_BLOCK_HEADER: return "accept_block_header";
+    case SyncStage::CONNECT_BLOCK: return "connect_block";
+    case SyncStage::FIND_NEXT_BLOCKS: return "find_next_blocks";
+    }
+    assert(false);
+}
+
+void CSyncStats::Record(SyncStage stage, int64_t nMicros, uint64_t nItems)
+{
+    LOCK(cs);
+    Stage& s = m_stages[static_cast<int>(stage)];
+    s.nCount++;
+    s.nTotal += nMicros;
+    s.nItems += nItems;
+    if (s.vRecent.size() < SYNC_STATS_WINDOW) {
+        s.vRecent.push_back(nMicros);
+    } else {
+        s.vRecent[s.nNext] = nMicros;
+        s.nNext = (s.nNext + 1) % SYNC_STATS_WINDOW;
+    }
+}
+
+CSyncStageStats CSyncStats::Get(SyncStage stage) const
+{
+    Stage s;
+    {
+        LOCK(cs);
+        s = m_stages[static_cast<int>(stage)];
+    }
+    return Summarize(s);
+}
+
+std::vector<CSyncStageStats> CSyncStats::GetAndReset()
+{
+    std::vector<Stage> vStages(NUM_SYNC_STAGES);
+    {
+        LOCK(cs);
+        for (int i = 0; i < NUM_SYNC_STAGES; i++) {
+            vStages[i] = std::move(m_stages[i]);
+            m_stages[i] = Stage();
+        }
+    }
+    std::vector<CSyncStageStats> vStats;
+    for (Stage& s : vStages)
+        vStats.push_back(Summarize(s));
+    return vStats;
+}
+
+CSyncStageStats CSyncStats::Summarize(Stage& s)
+{
+    CSyncStageStats stats;
+    stats.nCount = s.nCount;
+    stats.nTotal = s.nTotal;
+    stats.nItems = s.nItems;
+    std::vector<int64_t>& vSorted = s.vRecent;
+    if (vSorted.empty())
+        return stats;
+
+    std::sort(vSorted.begin(), vSorted.end());
+    // Nearest rank, so that every reported value is one that was recorded
+    auto percentile = [&vSorted](int p) { return vSorted[(vSorted.size() * p + 99) / 100 - 1]; };
+    stats.nWindow = vSorted.size();
+    stats.nMedian = percentile(50);
+    stats.nPercentile90 = percentile(90);
+    stats.nPercentile99 = percentile(99);
+    stats.nMax = vSorted.back();
+    return stats;
+}
+
+void CSyncStats::Reset()
+{
+    LOCK(cs);
+    for (Stage& s : m_stages)
+        s = Stage();
+}
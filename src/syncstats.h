@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef DIGIBYTE_SYNCSTATS_H
+#define DIGIBYTE_SYNCSTATS_H
+
+#include <sync.h>
+#include <utiltime.h>
+
+#include <stdint.h>
+#include <vector>
+
+/** Stages of header and block sync whose duration is recorded for getsyncstats. */
+enum class SyncStage {
+    PROCESS_HEADERS,       //!< ProcessHeadersMessage, once per HEADERS message
+    ACCEPT_BLOCK_HEADER,   //!< AcceptBlockHeader, once per header
+    CONNECT_BLOCK,         //!< ConnectBlock, once per block
+    FIND_NEXT_BLOCKS,      //!< FindNextBlocksToDownload, once per peer and SendMessages
+};
+
+static const int NUM_SYNC_STAGES = 4;
+
+/** Number of most recent durations of each stage that percentiles are taken over. */
+static const size_t SYNC_STATS_WINDOW = 1000;
+
+/** Name of a stage, as reported by getsyncstats. */
+const char* SyncStageName(SyncStage stage);
+
+/** Summary of the durations recorded for one stage, in microseconds. */
+struct CSyncStageStats
+{
+    uint64_t nCount = 0;       //!< Durations recorded since startup
+    int64_t nTotal = 0;        //!< Sum of the durations recorded since startup
+    uint64_t nItems = 0;       //!< Headers or blocks handled since startup
+    size_t nWindow = 0;        //!< Durations the percentiles below are taken over
+    int64_t nMedian = 0;
+    int64_t nPercentile90 = 0;
+    int64_t nPercentile99 = 0;
+    int64_t nMax = 0;
+};
+
+/**
+ * Durations of the stages of header and block sync. Each stage keeps running
+ * totals, and the most recent SYNC_STATS_WINDOW durations in a ring buffer so
+ * that percentiles follow the current phase of the sync.
+ */
+class CSyncStats
+{
+public:
+    void Record(SyncStage stage, int64_t nMicros, uint64_t nItems = 1);
+    CSyncStageStats Get(SyncStage stage) const;
+    //! Summaries of all stages, indexed by stage, taken and cleared atomically
+    std::vector<CSyncStageStats> GetAndReset();
+    void Reset();
+
+private:
+    struct Stage
+    {
+        uint64_t nCount = 0;
+        int64_t nTotal = 0;
+        uint64_t nItems = 0;
+        std::vector<int64_t> vRecent;
+        size_t nNext = 0;
+    };
+
+    static CSyncStageStats Summarize(Stage& s);
+
+    mutable CCriticalSection cs;
+    Stage m_stages[NUM_SYNC_STAGES];
+};
+
+extern CSyncStats g_sync_stats;
+
+/** Records the time spent in its scope as one duration of a stage. */
+class CSyncStageTimer
+{
+public:
+    explicit CSyncStageTimer(SyncStage stage, uint64_t nItems = 1) : m_stage(stage), m_items(nItems), m_start(GetTimeMicros()) {}
+    ~CSyncStageTimer() { g_sync_stats.Record(m_stage, GetTimeMicros() - m_start, m_items); }
+
+    CSyncStageTimer(const CSyncStageTimer&) = delete;
+    CSyncStageTimer& operator=(const CSyncStageTimer&) = delete;
+
+private:
+    const SyncStage m_stage;
+    const uint64_t m_items;
+    const int64_t m_start;
+};
+
+#endif // DIGIBYTE_SYNCSTATS_H
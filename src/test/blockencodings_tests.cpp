@@ -278,6 +278,46 @@ BOOST_AUTO_TEST_CASE(SufficientPreforwardRTTest)
     BOOST_CHECK_EQUAL(pool.mapTx.find(txhash)->GetSharedTx().use_count(), SHARED_TX_OFFSET - 1); // -1 because of block
 }
 
+BOOST_AUTO_TEST_CASE(MempoolPredictedPrefillRTTest)
+{
+    CTxMemPool pool;
+    TestMemPoolEntryHelper entry;
+    CBlock block(BuildBlockTestCase());
+
+    LOCK(pool.cs);
+    pool.addUnchecked(block.vtx[2]->GetHash(), entry.FromTx(block.vtx[2]));
+
+    // vtx[1] is missing from the sender's mempool, so it gets prefilled next to the coinbase
+    CBlockHeaderAndShortTxIDs shortIDs(block, true, &pool);
+    TestHeaderAndShortIDs shortIDsRaw(shortIDs);
+    BOOST_CHECK_EQUAL(shortIDsRaw.prefilledtxn.size(), 2U);
+    BOOST_CHECK_EQUAL(shortIDsRaw.prefilledtxn[1].index, 0);
+    BOOST_CHECK_EQUAL(shortIDsRaw.shorttxids.size(), 1U);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << shortIDs;
+
+    CBlockHeaderAndShortTxIDs shortIDs2;
+    stream >> shortIDs2;
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs2, extra_txn) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+    BOOST_CHECK(partialBlock.IsTxAvailable(1));
+    BOOST_CHECK(partialBlock.IsTxAvailable(2));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, {}) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block.GetHash().ToString(), block2.GetHash().ToString());
+
+    // Nothing is prefilled beyond MAX_CMPCTBLOCK_PREFILL_BYTES
+    CMutableTransaction tx(*block.vtx[1]);
+    tx.vin[0].scriptSig.resize(MAX_CMPCTBLOCK_PREFILL_BYTES);
+    block.vtx[1] = MakeTransactionRef(tx);
+    CBlockHeaderAndShortTxIDs shortIDs3(block, true, &pool);
+    BOOST_CHECK_EQUAL(TestHeaderAndShortIDs(shortIDs3).prefilledtxn.size(), 1U);
+}
+
 BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
 {
     CTxMemPool pool;
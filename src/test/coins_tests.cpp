@@ -3,12 +3,17 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chainparams.h>
 #include <coins.h>
+#include <coinstats.h>
+#include <key.h>
+#include <script/sign.h>
 #include <script/standard.h>
 #include <uint256.h>
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_digibyte.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -856,4 +861,321 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_take_dirty)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    const COutPoint old_coin(InsecureRand256(), 0), new_coin(InsecureRand256(), 0), spent_coin(InsecureRand256(), 0);
+    Coin coin;
+    SetCoinsValue(1, coin);
+    {
+        CCoinsViewCacheTest parent(&base);
+        parent.AddCoin(old_coin, Coin(coin), false);
+        parent.AddCoin(spent_coin, Coin(coin), false);
+        BOOST_CHECK(parent.Flush());
+    }
+
+    // An unmodified coin loaded from the base, a new one and a spent one
+    BOOST_CHECK(!cache.AccessCoin(old_coin).IsSpent());
+    cache.AddCoin(new_coin, Coin(coin), false);
+    BOOST_CHECK(cache.SpendCoin(spent_coin));
+
+    // Only room for the new coin: it is taken out and stays cached, unmodified
+    const size_t chunk_usage = memusage::MallocUsage(CCoinsMapMemoryResource().ChunkSizeBytes()) + memusage::MallocUsage(sizeof(void*) * 3);
+    const size_t entry_usage = memusage::MallocUsage(sizeof(CoinsCachePair) + 2 * sizeof(void*)) + 2 * sizeof(void*) + coin.DynamicMemoryUsage();
+    CCoinsMap dirty = cache.TakeDirtyEntries(chunk_usage + entry_usage * 3);
+    cache.SelfTest();
+    BOOST_CHECK_EQUAL(dirty.size(), 2U);
+    BOOST_CHECK(dirty.at(new_coin).flags & CCoinsCacheEntry::DIRTY);
+    BOOST_CHECK(dirty.at(spent_coin).coin.IsSpent());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK(cache.HaveCoinInCache(new_coin));
+    BOOST_CHECK_EQUAL(cache.map().at(new_coin).flags, 0);
+
+    // With more room, unmodified coins stay as well
+    BOOST_CHECK(!cache.AccessCoin(old_coin).IsSpent());
+    BOOST_CHECK(cache.TakeDirtyEntries(chunk_usage + entry_usage * 3).empty());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+    BOOST_CHECK(cache.TakeDirtyEntries(0).empty());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_take_dirty_usage)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    Coin coin;
+    SetCoinsValue(1, coin);
+    std::vector<COutPoint> old_coins;
+    {
+        CCoinsViewCacheTest parent(&base);
+        for (int i = 0; i < 20000; i++) {
+            old_coins.emplace_back(InsecureRand256(), 0);
+            parent.AddCoin(old_coins.back(), Coin(coin), false);
+        }
+        BOOST_CHECK(parent.Flush());
+    }
+
+    // A cache spanning many chunks, mostly of unmodified coins
+    for (const COutPoint& outpoint : old_coins) {
+        BOOST_CHECK(!cache.AccessCoin(outpoint).IsSpent());
+    }
+    for (int i = 0; i < 2000; i++) {
+        cache.AddCoin(COutPoint(InsecureRand256(), 0), Coin(coin), false);
+    }
+    for (int i = 0; i < 2000; i++) {
+        BOOST_CHECK(cache.SpendCoin(old_coins[i]));
+    }
+
+    // The memory of the entries that are not kept is given back, rather than
+    // staying in the chunks of the cache
+    const size_t max_usage = cache.DynamicMemoryUsage() / 2;
+    CCoinsMap dirty = cache.TakeDirtyEntries(max_usage);
+    BOOST_CHECK_EQUAL(dirty.size(), 4000U);
+    BOOST_CHECK(cache.GetCacheSize() > 0);
+    BOOST_CHECK(cache.GetCacheSize() < 18000U);
+    BOOST_CHECK(cache.DynamicMemoryUsage() < max_usage);
+    cache.SelfTest();
+
+    // The cache keeps working on its new memory
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(cache.AccessCoin(old_coins.back()).out == coin.out);
+    cache.SelfTest();
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_add_fetched)
+{
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    const COutPoint fetched_coin(InsecureRand256(), 0), spent_coin(InsecureRand256(), 0);
+    Coin coin;
+    SetCoinsValue(1, coin);
+    {
+        CCoinsViewCacheTest parent(&base);
+        parent.AddCoin(fetched_coin, Coin(coin), false);
+        parent.AddCoin(spent_coin, Coin(coin), false);
+        BOOST_CHECK(parent.Flush());
+    }
+
+    // A prefetched coin is cached unmodified and accounted for
+    cache.AddFetchedCoin(fetched_coin, Coin(coin));
+    BOOST_CHECK(cache.HaveCoinInCache(fetched_coin));
+    BOOST_CHECK_EQUAL(cache.map().at(fetched_coin).flags, 0);
+    cache.SelfTest();
+
+    // It does not override an entry the cache already has
+    BOOST_CHECK(cache.SpendCoin(spent_coin));
+    cache.AddFetchedCoin(spent_coin, Coin(coin));
+    BOOST_CHECK(!cache.HaveCoinInCache(spent_coin));
+    BOOST_CHECK(cache.map().at(spent_coin).flags & CCoinsCacheEntry::DIRTY);
+    cache.SelfTest();
+
+    BOOST_CHECK(cache.Flush());
+    Coin result;
+    BOOST_CHECK(base.GetCoin(fetched_coin, result) && !result.IsSpent());
+    BOOST_CHECK(!base.GetCoin(spent_coin, result) || result.IsSpent());
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_prefetch_block_inputs, TestChain100Setup)
+{
+    // Spend coins that are only in the database, so that connecting the block
+    // looks them up on the prefetch threads
+    FlushStateToDisk();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(4);
+    for (size_t i = 0; i < spend.vin.size(); i++) {
+        spend.vin[i].prevout = COutPoint(m_coinbase_txns[i]->GetHash(), 0);
+        BOOST_CHECK(!pcoinsTip->HaveCoinInCache(spend.vin[i].prevout));
+    }
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = scriptPubKey;
+    for (size_t i = 0; i < spend.vin.size(); i++) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[i].scriptSig << vchSig;
+    }
+
+    CBlock block = CreateAndProcessBlock({spend}, scriptPubKey);
+    LOCK(cs_main);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    for (const CTxIn& txin : spend.vin)
+        BOOST_CHECK(!pcoinsTip->HaveCoin(txin.prevout));
+    BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(spend.GetHash(), 0)));
+}
+
+static void CheckUTXOSetStats()
+{
+    FlushStateToDisk();
+    LOCK(cs_main);
+    CUTXOSetStats rolling, stored, computed;
+    BOOST_CHECK(GetUTXOSetStats(rolling));
+    BOOST_CHECK(pcoinsdbview->GetUTXOSetStats(stored));
+    BOOST_CHECK(ComputeUTXOSetStats(*pcoinsdbview, computed, 3));
+    BOOST_CHECK(rolling.hashBlock == chainActive.Tip()->GetBlockHash());
+    for (const CUTXOSetStats& stats : {stored, computed}) {
+        BOOST_CHECK(stats.hashBlock == rolling.hashBlock);
+        BOOST_CHECK_EQUAL(stats.nTransactionOutputs, rolling.nTransactionOutputs);
+        BOOST_CHECK_EQUAL(stats.nTotalAmount, rolling.nTotalAmount);
+        BOOST_CHECK_EQUAL(stats.nBogoSize, rolling.nBogoSize);
+        BOOST_CHECK(stats.GetMuHash() == rolling.GetMuHash());
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_utxo_set_stats, TestChain100Setup)
+{
+    // Nothing is maintained unless -utxosetcommitment loads the stats
+    CUTXOSetStats stats;
+    BOOST_CHECK(!GetUTXOSetStats(stats));
+    FlushStateToDisk();
+    BOOST_CHECK(!pcoinsdbview->GetUTXOSetStats(stats));
+
+    // Loading them computes them over the database once
+    BOOST_CHECK(LoadUTXOSetStats());
+    CheckUTXOSetStats();
+    CUTXOSetStats before;
+    BOOST_CHECK(GetUTXOSetStats(before));
+
+    // Spend two coinbases, create an unspendable output, and spend one of the
+    // new outputs again in the same block
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CMutableTransaction spend;
+    spend.nVersion = 1;
+    spend.vin.resize(2);
+    spend.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHash(), 0);
+    spend.vin[1].prevout = COutPoint(m_coinbase_txns[1]->GetHash(), 0);
+    spend.vout.resize(3);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    spend.vout[1].nValue = 12 * CENT;
+    spend.vout[1].scriptPubKey = scriptPubKey;
+    spend.vout[2].nValue = 0;
+    spend.vout[2].scriptPubKey = CScript() << OP_RETURN;
+    for (size_t i = 0; i < spend.vin.size(); i++) {
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, spend, i, SIGHASH_ALL, 0, SigVersion::BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        spend.vin[i].scriptSig << vchSig;
+    }
+    CMutableTransaction chained;
+    chained.nVersion = 1;
+    chained.vin.resize(1);
+    chained.vin[0].prevout = COutPoint(spend.GetHash(), 0);
+    chained.vout.resize(1);
+    chained.vout[0].nValue = 10 * CENT;
+    chained.vout[0].scriptPubKey = scriptPubKey;
+
+    CBlock block = CreateAndProcessBlock({spend, chained}, scriptPubKey);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    }
+    CheckUTXOSetStats();
+
+    // Disconnecting the block takes the stats back to where they were
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    }
+    CheckUTXOSetStats();
+    CUTXOSetStats after;
+    BOOST_CHECK(GetUTXOSetStats(after));
+    BOOST_CHECK(after.hashBlock == before.hashBlock);
+    BOOST_CHECK_EQUAL(after.nTransactionOutputs, before.nTransactionOutputs);
+    BOOST_CHECK(after.GetMuHash() == before.GetMuHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_write_async, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true);
+    const COutPoint outpoint1(InsecureRand256(), 0), outpoint2(InsecureRand256(), 1);
+    const uint256 block1 = InsecureRand256(), block2 = InsecureRand256();
+    Coin coin;
+    SetCoinsValue(1, coin);
+
+    CCoinsMap map;
+    map.emplace(outpoint1, CCoinsCacheEntry(Coin(coin))).first->second.flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(db.BatchWrite(map, block1));
+    BOOST_CHECK(map.empty());
+
+    // Spend the first coin and create the second, in the background
+    map.emplace(outpoint1, CCoinsCacheEntry()).first->second.flags = CCoinsCacheEntry::DIRTY;
+    map.emplace(outpoint2, CCoinsCacheEntry(Coin(coin))).first->second.flags = CCoinsCacheEntry::DIRTY;
+    db.BatchWriteAsync(std::move(map), block2);
+
+    // Reads are consistent with block2 whether or not the write is done
+    Coin result;
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    BOOST_CHECK(!db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.GetCoin(outpoint2, result) && result == coin);
+    BOOST_CHECK(db.WaitForPendingWrite());
+    BOOST_CHECK_EQUAL(db.PendingMemoryUsage(), 0U);
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    BOOST_CHECK(!db.HaveCoin(outpoint1));
+    BOOST_CHECK(db.GetCoin(outpoint2, result) && result == coin);
+}
+
+BOOST_FIXTURE_TEST_CASE(coins_db_cursors, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true);
+    uint256 block = InsecureRand256();
+    CCoinsMap map;
+    // Transactions with several outputs, some with txids right at a boundary
+    // between two shards
+    for (int i = 0; i < 200; i++) {
+        uint256 txid = InsecureRand256();
+        if (i % 10 == 0) {
+            *txid.begin() = 0x80;
+            *(txid.begin() + 1) = 0x00;
+        }
+        for (uint32_t n = 0; n <= InsecureRandRange(3); n++) {
+            Coin coin;
+            SetCoinsValue(1 + InsecureRandRange(1000), coin);
+            map.emplace(COutPoint(txid, n), CCoinsCacheEntry(std::move(coin))).first->second.flags = CCoinsCacheEntry::DIRTY;
+        }
+    }
+    BOOST_CHECK(db.BatchWrite(map, block));
+
+    for (size_t shards : {1, 2, 3, 256, 1000}) {
+        std::vector<COutPoint> expected;
+        std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+        for (; cursor->Valid(); cursor->Next()) {
+            COutPoint key;
+            BOOST_CHECK(cursor->GetKey(key));
+            expected.push_back(key);
+        }
+
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = db.Cursors(shards);
+        BOOST_CHECK_EQUAL(cursors.size(), shards);
+
+        // A coin written after the cursors are created is not visible to them
+        Coin coin;
+        SetCoinsValue(1, coin);
+        map.emplace(COutPoint(InsecureRand256(), 0), CCoinsCacheEntry(std::move(coin))).first->second.flags = CCoinsCacheEntry::DIRTY;
+        const uint256 prev_block = block;
+        block = InsecureRand256();
+        BOOST_CHECK(db.BatchWrite(map, block));
+
+        std::vector<COutPoint> found;
+        for (const auto& shard : cursors) {
+            BOOST_CHECK(shard->GetBestBlock() == prev_block);
+            for (; shard->Valid(); shard->Next()) {
+                COutPoint key;
+                Coin value;
+                BOOST_CHECK(shard->GetKey(key));
+                BOOST_CHECK(shard->GetValue(value));
+                found.push_back(key);
+            }
+        }
+        BOOST_CHECK(found == expected);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
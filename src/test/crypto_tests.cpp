@@ -5,15 +5,22 @@
 
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
+#include <crypto/hashgroestl.h>
+#include <crypto/hashodo.h>
+#include <crypto/hashqubit.h>
+#include <crypto/muhash.h>
 #include <crypto/odocrypt.h>
 #include <crypto/ripemd160.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
 #include <random.h>
+#include <streams.h>
 #include <utilstrencodings.h>
+#include <version.h>
 #include <test/test_digibyte.h>
 #include <vector>
 #include <boost/test/unit_test.hpp>
@@ -593,6 +600,101 @@ BOOST_AUTO_TEST_CASE(sha256d64)
     }
 }
 
+BOOST_AUTO_TEST_CASE(odo_cache)
+{
+    char header[OdoCrypt::DIGEST_SIZE];
+    for (int i = 0; i < OdoCrypt::DIGEST_SIZE; i++)
+        header[i] = InsecureRandBits(8);
+    // Cycle through more keys than the cache holds, so entries get evicted and rebuilt.
+    for (int round = 0; round < 3; round++) {
+        for (uint32_t key = 0; key < 20; key++) {
+            BOOST_CHECK(HashOdo(header, header + sizeof(header), key) == HashOdo(header, header + sizeof(header), OdoCrypt(key)));
+        }
+    }
+    BOOST_CHECK(GetOdoCrypt(12345) == GetOdoCrypt(12345));
+}
+
+BOOST_AUTO_TEST_CASE(scrypt_multi)
+{
+    for (int i = 0; i <= 18; i += 6) {
+        char in[80 * 18];
+        char out1[32 * 18], out2[32 * 18];
+        for (int j = 0; j < 80 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            scrypt_1024_1_1_256(in + 80 * j, out1 + 32 * j);
+        }
+        scrypt_1024_1_1_256_multi(in, out2, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(qubit_stages)
+{
+    // Whatever QubitAutoDetect selected must match the portable sph code
+    for (int i = 0; i < 32; i++) {
+        unsigned char in[64], out[64], expected[64];
+        for (int j = 0; j < 64; j++) {
+            in[j] = InsecureRandBits(8);
+        }
+
+        sph_cubehash512_context ctx_cubehash;
+        sph_cubehash512_init(&ctx_cubehash);
+        sph_cubehash512(&ctx_cubehash, in, 64);
+        sph_cubehash512_close(&ctx_cubehash, expected);
+        QubitCubehash512(in, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+
+        sph_shavite512_context ctx_shavite;
+        sph_shavite512_init(&ctx_shavite);
+        sph_shavite512(&ctx_shavite, in, 64);
+        sph_shavite512_close(&ctx_shavite, expected);
+        QubitShavite512(in, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+
+        sph_simd512_context ctx_simd;
+        sph_simd512_init(&ctx_simd);
+        sph_simd512(&ctx_simd, in, 64);
+        sph_simd512_close(&ctx_simd, expected);
+        QubitSimd512(in, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+
+        sph_echo512_context ctx_echo;
+        sph_echo512_init(&ctx_echo);
+        sph_echo512(&ctx_echo, in, 64);
+        sph_echo512_close(&ctx_echo, expected);
+        QubitEcho512(in, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+
+        // The stages hashing a whole header
+        unsigned char header[80];
+        for (int j = 0; j < 80; j++) {
+            header[j] = InsecureRandBits(8);
+        }
+
+        sph_luffa512_context ctx_luffa;
+        sph_luffa512_init(&ctx_luffa);
+        sph_luffa512(&ctx_luffa, header, 80);
+        sph_luffa512_close(&ctx_luffa, expected);
+        QubitLuffa512(header, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+
+        sph_groestl512_context ctx_groestl;
+        sph_groestl512_init(&ctx_groestl);
+        sph_groestl512(&ctx_groestl, header, 80);
+        sph_groestl512_close(&ctx_groestl, expected);
+        Groestl512Header(header, out);
+        BOOST_CHECK(memcmp(out, expected, 64) == 0);
+    }
+
+    unsigned char header[80];
+    for (int i = 0; i < 80; i++) {
+        header[i] = i;
+    }
+    BOOST_CHECK_EQUAL(HashQubit(header, header + 80).GetHex(), "157c17db4331cd2ace34975ee741a201e8c9ce0b586d0ce1f95a7a27c95f445f");
+}
+
 BOOST_AUTO_TEST_CASE(odo_permutation)
 {
     char buf[OdoCrypt::DIGEST_SIZE];
@@ -606,4 +708,78 @@ BOOST_AUTO_TEST_CASE(odo_permutation)
         BOOST_CHECK(buf[i] == i);
 }
 
+static std::vector<unsigned char> IntBytes(unsigned char i)
+{
+    std::vector<unsigned char> tmp(32, 0);
+    tmp[0] = i;
+    return tmp;
+}
+
+static MuHash3072 FromInt(unsigned char i)
+{
+    std::vector<unsigned char> tmp = IntBytes(i);
+    return MuHash3072(Span<const unsigned char>(tmp.data(), tmp.size()));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out, out2;
+
+    // The empty set and a set with elements inserted and removed again hash the same
+    MuHash3072().Finalize(out);
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(0);
+    acc /= FromInt(1);
+    acc.Finalize(out2);
+    BOOST_CHECK(out == out2);
+
+    // Order does not matter, whether elements are inserted or multiplied in
+    for (int iter = 0; iter < 10; ++iter) {
+        unsigned char x = InsecureRandBits(8), y = InsecureRandBits(8), z = InsecureRandBits(8);
+        uint256 res1, res2;
+        MuHash3072 a = FromInt(x);
+        a *= FromInt(y);
+        a *= FromInt(z);
+        a.Finalize(res1);
+        MuHash3072 b = FromInt(z);
+        b *= FromInt(x);
+        b *= FromInt(y);
+        b.Finalize(res2);
+        BOOST_CHECK(res1 == res2);
+
+        const std::vector<unsigned char> tx = IntBytes(x), ty = IntBytes(y), tz = IntBytes(z);
+        MuHash3072 c;
+        c.Insert(MakeSpan(tz)).Insert(MakeSpan(ty)).Insert(MakeSpan(tx));
+        c.Finalize(res2);
+        BOOST_CHECK(res1 == res2);
+
+        // Removing an element gives the hash of the rest
+        c.Remove(MakeSpan(tz));
+        c.Finalize(res2);
+        MuHash3072 d = FromInt(x);
+        d *= FromInt(y);
+        d.Finalize(res1);
+        BOOST_CHECK(res1 == res2);
+    }
+
+    // Different sets hash differently
+    FromInt(1).Finalize(out);
+    FromInt(2).Finalize(out2);
+    BOOST_CHECK(out != out2);
+
+    // A serialized set, with a pending removal, round trips
+    MuHash3072 set = FromInt(1);
+    set *= FromInt(2);
+    set /= FromInt(3);
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << set;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 set2;
+    ss >> set2;
+    set.Finalize(out);
+    set2.Finalize(out2);
+    BOOST_CHECK(out == out2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
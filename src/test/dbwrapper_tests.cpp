@@ -239,6 +239,44 @@ BOOST_AUTO_TEST_CASE(iterator_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(snapshot_iterators)
+{
+    fs::path ph = SetDataDir("snapshot_iterators");
+    CDBWrapper dbw(ph, (1 << 20), true, false, false);
+    for (uint8_t key = 0x00; key < 0x80; ++key) {
+        BOOST_CHECK(dbw.Write(key, (uint32_t)key));
+    }
+
+    std::vector<std::unique_ptr<CDBIterator>> iterators = dbw.NewSnapshotIterators(2);
+    BOOST_CHECK_EQUAL(iterators.size(), 2U);
+
+    // Neither iterator sees writes made after they were created, including
+    // the one that is first used after the writes
+    iterators[0]->Seek((uint8_t)0x00);
+    for (uint8_t key = 0x00; key < 0x80; ++key) {
+        BOOST_CHECK(dbw.Write(key, (uint32_t)key + 1));
+        BOOST_CHECK(dbw.Write((uint8_t)(key + 0x80), (uint32_t)key));
+    }
+    iterators[1]->Seek((uint8_t)0x40);
+
+    for (int i = 0; i < 2; i++) {
+        CDBIterator& it = *iterators[i];
+        for (unsigned int x = i * 0x40; x < 0x80; ++x) {
+            uint8_t key;
+            uint32_t value;
+            BOOST_CHECK(it.Valid());
+            if (!it.Valid()) // Avoid spurious errors about invalid iterator's key and value in case of failure
+                break;
+            BOOST_CHECK(it.GetKey(key));
+            BOOST_CHECK(it.GetValue(value));
+            BOOST_CHECK_EQUAL(key, x);
+            BOOST_CHECK_EQUAL(value, x);
+            it.Next();
+        }
+        BOOST_CHECK(!it.Valid());
+    }
+}
+
 struct StringContentsSerializer {
     // Used to make two serialized objects the same while letting them have different lengths
     // This is a terrible idea
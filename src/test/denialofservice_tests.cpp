@@ -416,4 +416,45 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactions.empty());
 }
 
+BOOST_AUTO_TEST_CASE(block_download_limits)
+{
+    // Peers without a measured rate keep the fixed limits
+    BOOST_CHECK_EQUAL(GetMaxBlocksInFlight(0, 0, 0, 0), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(0), (int)BLOCK_DOWNLOAD_WINDOW);
+    BOOST_CHECK_EQUAL(GetBlockStallingTimeout(0, 0, 500000, 1000000), 1000000 * BLOCK_STALLING_TIMEOUT);
+
+    // 1 MB/s of 10 kB blocks over a 200 ms round trip: 1.2 s worth of blocks in flight
+    BOOST_CHECK_EQUAL(GetMaxBlocksInFlight(10000, 10000, 200000, 10000), 120);
+    // Slow peers and large blocks never go below the fixed limit, fast ones are capped
+    BOOST_CHECK_EQUAL(GetMaxBlocksInFlight(10000, 1000000, 200000, 10000), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetMaxBlocksInFlight(10000, 1, 200000, 10000), MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE);
+
+    // The window spans BLOCK_DOWNLOAD_WINDOW_BYTES of blocks, within bounds
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(10000), BLOCK_DOWNLOAD_WINDOW_BYTES / 10000);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(1000), (int)MAX_BLOCK_DOWNLOAD_WINDOW);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(1000000), (int)BLOCK_DOWNLOAD_WINDOW);
+
+    // 5 MB in flight at 1 MB/s over a 200 ms round trip may take twice 5.2 s
+    BOOST_CHECK_EQUAL(GetBlockStallingTimeout(10000, 10000, 200000, 5000000), 10400000);
+    BOOST_CHECK_EQUAL(GetBlockStallingTimeout(10000, 10000, 0, 1000), 1000000 * BLOCK_STALLING_TIMEOUT);
+    BOOST_CHECK_EQUAL(GetBlockStallingTimeout(10000, 10000, 0, 1000000000), 1000000 * BLOCK_STALLING_TIMEOUT_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(block_transfer_time)
+{
+    // A block requested while the previous one was still on its way takes from that arrival,
+    // one requested after it from the request, round trip included
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1000000, 1500000, 1800000, 10000), 300000);
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1500000, 1000000, 1800000, 10000), 300000);
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1000000, 0, 1800000, 10000), 800000);
+
+    // Blocks arriving together are taken to have come at MAX_BLOCK_DOWNLOAD_RATE at most,
+    // so that a burst can't make a peer look arbitrarily fast
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1000000, 1800000, 1800000, 1000000), (int64_t)1000000 * 1000000 / MAX_BLOCK_DOWNLOAD_RATE);
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1000000, 1799990, 1800000, 1000000), 8000);
+    BOOST_CHECK_EQUAL(GetBlockTransferTime(1000000, 1800000, 1800000, 100), 1);
+    // The resulting rate keeps the in-flight limit bounded
+    BOOST_CHECK_EQUAL(GetMaxBlocksInFlight(1000000, GetBlockTransferTime(1000000, 1800000, 1800000, 1000000), 0, 1000000), 125);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
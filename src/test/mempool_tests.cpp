@@ -6,6 +6,7 @@
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util.h>
+#include <validation.h>
 
 #include <test/test_digibyte.h>
 
@@ -118,6 +119,80 @@ static void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder) E
     }
 }
 
+BOOST_AUTO_TEST_CASE(MempoolStemOverlayTest)
+{
+    // An overlay pool only holds its own transactions, spending parents from its base
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(3);
+    for (int i = 0; i < 3; i++)
+    {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000LL;
+    }
+    CMutableTransaction txChild[3];
+    for (int i = 0; i < 3; i++)
+    {
+        txChild[i].vin.resize(1);
+        txChild[i].vin[0].scriptSig = CScript() << OP_11;
+        txChild[i].vin[0].prevout = COutPoint(txParent.GetHash(), i);
+        txChild[i].vout.resize(1);
+        txChild[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txChild[i].vout[0].nValue = 11000LL;
+    }
+    CMutableTransaction txGrandChild;
+    txGrandChild.vin.resize(1);
+    txGrandChild.vin[0].scriptSig = CScript() << OP_11;
+    txGrandChild.vin[0].prevout = COutPoint(txChild[0].GetHash(), 0);
+    txGrandChild.vout.resize(1);
+    txGrandChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txGrandChild.vout[0].nValue = 11000LL;
+    // Spends the same output as txChild[1]
+    CMutableTransaction txConflict = txChild[1];
+    txConflict.vin[0].scriptSig = CScript() << OP_12;
+
+    CTxMemPool basePool;
+    CTxMemPool overlay(nullptr, &basePool);
+    BOOST_CHECK(overlay.GetBase() == &basePool);
+    {
+        LOCK2(basePool.cs, overlay.cs);
+        basePool.addUnchecked(txParent.GetHash(), entry.FromTx(txParent));
+        for (int i = 0; i < 3; i++)
+            overlay.addUnchecked(txChild[i].GetHash(), entry.FromTx(txChild[i]));
+        overlay.addUnchecked(txGrandChild.GetHash(), entry.FromTx(txGrandChild));
+    }
+    BOOST_CHECK_EQUAL(basePool.size(), 1U);
+    BOOST_CHECK_EQUAL(overlay.size(), 4U);
+
+    // Reaching the base takes a transaction out of the overlay, but not its descendants
+    {
+        LOCK(basePool.cs);
+        basePool.addUnchecked(txChild[0].GetHash(), entry.FromTx(txChild[0]));
+    }
+    overlay.removeForBase(txChild[0]);
+    BOOST_CHECK_EQUAL(overlay.size(), 3U);
+    BOOST_CHECK(overlay.exists(txGrandChild.GetHash()));
+    {
+        LOCK(overlay.cs);
+        BOOST_CHECK_EQUAL(overlay.mapTx.find(txGrandChild.GetHash())->GetCountWithAncestors(), 1U);
+    }
+
+    // A conflicting transaction reaching the base evicts the overlay's spender
+    overlay.removeForBase(txConflict);
+    BOOST_CHECK_EQUAL(overlay.size(), 2U);
+    BOOST_CHECK(!overlay.exists(txChild[1].GetHash()));
+
+    // Once the base drops the parents without them being mined, their spenders go too
+    overlay.removeOrphans(pcoinsTip.get(), basePool.TakeRemovedTxids());
+    BOOST_CHECK_EQUAL(overlay.size(), 2U);
+    basePool.removeRecursive(txParent);
+    BOOST_CHECK_EQUAL(basePool.size(), 0U);
+    overlay.removeOrphans(pcoinsTip.get(), basePool.TakeRemovedTxids());
+    BOOST_CHECK_EQUAL(overlay.size(), 0U);
+}
+
 BOOST_AUTO_TEST_CASE(MempoolIndexingTest)
 {
     CTxMemPool pool;
@@ -12,6 +12,7 @@
 #include <validation.h>
 #include <miner.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <pubkey.h>
 #include <script/standard.h>
 #include <txmempool.h>
@@ -228,6 +229,19 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_validity)
     // Simple block creation, nothing special yet:
     BOOST_CHECK(pblocktemplate = AssemblerForTest(chainparams).CreateNewBlock(scriptPubKey, ALGO_SCRYPT));
 
+    // A template assembled for one algo can be handed out for another
+    {
+        LOCK(cs_main);
+        CBlock block = pblocktemplate->block;
+        UpdateAlgo(&block, chainparams, chainActive.Tip(), ALGO_SHA256D);
+        BOOST_CHECK_EQUAL(block.GetAlgo(), ALGO_SHA256D);
+        BOOST_CHECK_EQUAL(block.nBits, GetNextWorkRequired(chainActive.Tip(), &block, chainparams.GetConsensus(), ALGO_SHA256D));
+        BOOST_CHECK(block.hashMerkleRoot == pblocktemplate->block.hashMerkleRoot);
+        UpdateAlgo(&block, chainparams, chainActive.Tip(), ALGO_SCRYPT);
+        BOOST_CHECK_EQUAL(block.nVersion, pblocktemplate->block.nVersion);
+        BOOST_CHECK_EQUAL(block.nBits, pblocktemplate->block.nBits);
+    }
+
     // We can't make transactions until we have inputs
     // Therefore, load 100 blocks :)
     int baseheight = 0;
@@ -228,4 +228,65 @@ BOOST_AUTO_TEST_CASE(ipv4_peer_with_ipv6_addrMe_test)
     BOOST_CHECK(1);
 }
 
+BOOST_AUTO_TEST_CASE(dandelion_embargo_expiry)
+{
+    CConnman connman(0x1337, 0x1337);
+    const uint256 a = InsecureRand256(), b = InsecureRand256(), c = InsecureRand256();
+
+    BOOST_CHECK(connman.insertDandelionEmbargo(a, 300));
+    BOOST_CHECK(connman.insertDandelionEmbargo(b, 100));
+    BOOST_CHECK(connman.insertDandelionEmbargo(c, 200));
+    // an embargo is only ever set once
+    BOOST_CHECK(!connman.insertDandelionEmbargo(a, 50));
+    BOOST_CHECK(connman.isTxDandelionEmbargoed(a));
+
+    BOOST_CHECK(connman.popExpiredDandelionEmbargoes(100).empty());
+
+    // removed embargoes never expire
+    BOOST_CHECK(connman.removeDandelionEmbargo(c));
+    BOOST_CHECK(!connman.removeDandelionEmbargo(c));
+    BOOST_CHECK(!connman.isTxDandelionEmbargoed(c));
+
+    std::vector<uint256> vExpired = connman.popExpiredDandelionEmbargoes(1000);
+    BOOST_CHECK_EQUAL(vExpired.size(), 2U);
+    BOOST_CHECK(vExpired[0] == b);
+    BOOST_CHECK(vExpired[1] == a);
+    BOOST_CHECK(!connman.isTxDandelionEmbargoed(a));
+    BOOST_CHECK(connman.popExpiredDandelionEmbargoes(1000).empty());
+}
+
+BOOST_AUTO_TEST_CASE(dandelion_stem_inventory_batch)
+{
+    in_addr ipv4AddrPeer;
+    ipv4AddrPeer.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4AddrPeer, 7777), NODE_NETWORK);
+    std::unique_ptr<CNode> pnode = MakeUnique<CNode>(0, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0, CAddress{}, std::string{}, false);
+    const uint256 a = InsecureRand256(), b = InsecureRand256();
+
+    // a transaction is queued once until the batch is sent
+    pnode->PushInventory(CInv(MSG_DANDELION_TX, a));
+    pnode->PushInventory(CInv(MSG_DANDELION_TX, b));
+    pnode->PushInventory(CInv(MSG_DANDELION_TX, a));
+    BOOST_CHECK_EQUAL(pnode->mapInventoryDandelionTxToSend.size(), 2U);
+
+    // nor queued again once the peer knows about it
+    pnode->mapInventoryDandelionTxToSend.clear();
+    pnode->setDandelionInventoryKnown.insert(a);
+    pnode->PushInventory(CInv(MSG_DANDELION_TX, a));
+    BOOST_CHECK(pnode->mapInventoryDandelionTxToSend.empty());
+
+    CConnman connman(0x1337, 0x1337);
+    connman.RecordDandelionStemRelay(2, 3000);
+    connman.RecordDandelionStemRelay(1, 1000);
+    connman.RecordDandelionFluff();
+    connman.RecordDandelionEmbargoExpiry();
+    connman.RecordDandelionEmbargoExpiry();
+    CDandelionStats stats;
+    connman.GetDandelionStats(stats);
+    BOOST_CHECK_EQUAL(stats.nStemRelayed, 3U);
+    BOOST_CHECK_EQUAL(stats.nStemLatencyMicros, 4000);
+    BOOST_CHECK_EQUAL(stats.nFluffed, 1U);
+    BOOST_CHECK_EQUAL(stats.nEmbargoExpired, 2U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
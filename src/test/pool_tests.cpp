@@ -0,0 +1,86 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <memusage.h>
+#include <support/allocators/pool.h>
+
+#include <test/test_digibyte.h>
+
+#include <unordered_map>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(pool_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(pool_resource_reuse)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Blocks are carved out of one chunk, rounded up to the alignment
+    void* a = resource.Allocate(8, 8);
+    void* b = resource.Allocate(13, 8);
+    void* c = resource.Allocate(8, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK_EQUAL(static_cast<char*>(b) - static_cast<char*>(a), 8);
+    BOOST_CHECK_EQUAL(static_cast<char*>(c) - static_cast<char*>(b), 16);
+
+    // Freed blocks are handed out again for the same size only
+    resource.Deallocate(b, 13, 8);
+    BOOST_CHECK(resource.Allocate(24, 8) != b);
+    BOOST_CHECK(resource.Allocate(16, 8) == b);
+
+    // Too large or too strictly aligned allocations bypass the pool
+    void* large = resource.Allocate(65, 8);
+    void* aligned = resource.Allocate(8, 16);
+    resource.Deallocate(large, 65, 8);
+    resource.Deallocate(aligned, 8, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+
+    // A new chunk is taken when the current one runs out
+    for (int i = 0; i < 1024 / 64; i++) {
+        resource.Allocate(64, 8);
+    }
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+    BOOST_CHECK_EQUAL(resource.ChunkSizeBytes(), 1024U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map)
+{
+    typedef std::pair<const int, int> Pair;
+    typedef PoolAllocator<Pair, sizeof(Pair) + sizeof(void*) * 4> Allocator;
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Allocator> Map;
+
+    Allocator::ResourceType resource(4096);
+    {
+        Map map(0, std::hash<int>(), std::equal_to<int>(), &resource);
+        for (int i = 0; i < 1000; i++) {
+            map[i] = i;
+        }
+        for (int i = 0; i < 1000; i += 2) {
+            map.erase(i);
+        }
+        for (int i = 0; i < 1000; i++) {
+            BOOST_CHECK_EQUAL(map.count(i), static_cast<size_t>(i % 2));
+        }
+        // Usage accounts for the chunks and the bucket array
+        BOOST_CHECK(resource.NumAllocatedChunks() > 0);
+        BOOST_CHECK_EQUAL(memusage::DynamicUsage(map), (memusage::MallocUsage(4096) + memusage::MallocUsage(sizeof(void*) * 3)) * resource.NumAllocatedChunks() + memusage::MallocUsage(sizeof(void*) * map.bucket_count()));
+
+        // Erased entries are reused rather than taking new chunks
+        const size_t chunks = resource.NumAllocatedChunks();
+        for (int i = 0; i < 1000; i += 2) {
+            map[i] = i;
+        }
+        BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), chunks);
+    }
+
+    // Without a resource, the map allocates its nodes one by one
+    Map map;
+    map[1] = 1;
+    BOOST_CHECK(map.get_allocator().resource() == nullptr);
+    BOOST_CHECK_EQUAL(map.at(1), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include <pow.h>
 #include <random.h>
 #include <util.h>
+#include <validation.h>
 #include <test/test_digibyte.h>
 
 #include <boost/test/unit_test.hpp>
@@ -93,4 +94,143 @@ BOOST_AUTO_TEST_CASE(GetBlockProofEquivalentTime_test)
     }
 }
 
+/* Test that the proof recovered from nChainWork matches the multi-algo computation */
+BOOST_AUTO_TEST_CASE(GetBlockProof_chainwork_cache)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = Params().GetConsensus();
+    const int32_t algoVersions[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_GROESTL, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT};
+    std::vector<uint256> hashes(1600);
+    std::vector<CBlockIndex> blocks(1600);
+
+    LOCK(cs_main);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        hashes[i] = GetRandHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nVersion = BLOCK_VERSION_DEFAULT | algoVersions[InsecureRandRange(5)];
+        blocks[i].nTime = 1389392876 + i * params.nPowTargetSpacing + InsecureRandRange(10);
+        blocks[i].nBits = 0x1e0fffff;
+        blocks[i].BuildSkip();
+        blocks[i].BuildChainWork();
+        BOOST_CHECK(blocks[i].fHaveChainWork);
+    }
+    BOOST_CHECK(blocks.back().nHeight >= params.workComputationChangeTarget);
+
+    for (CBlockIndex& block : blocks) {
+        const arith_uint256 cached = GetBlockProof(block);
+        block.fHaveChainWork = false;
+        BOOST_CHECK(GetBlockProof(block) == cached);
+        block.fHaveChainWork = true;
+    }
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+/* Test that the per-algo links give the same result as walking pprev */
+BOOST_AUTO_TEST_CASE(GetLastBlockIndexForAlgo_links)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const int32_t algoVersions[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT, BLOCK_VERSION_ODO};
+    std::vector<CBlockIndex> linked(5000);
+    std::vector<CBlockIndex> unlinked(5000);
+
+    for (size_t i = 0; i < linked.size(); i++) {
+        // groestl only shows up in the first few blocks, like after the Odo swap
+        const int32_t nVersion = BLOCK_VERSION_DEFAULT | (i < 10 && i % 3 == 0 ? BLOCK_VERSION_GROESTL : algoVersions[InsecureRandRange(5)]);
+        for (std::vector<CBlockIndex>* blocks : {&linked, &unlinked}) {
+            (*blocks)[i].pprev = i ? &(*blocks)[i - 1] : nullptr;
+            (*blocks)[i].nHeight = i;
+            (*blocks)[i].nVersion = nVersion;
+            (*blocks)[i].nTime = 1389392876 + i * chainParams->GetConsensus().nPowTargetSpacing;
+        }
+        linked[i].BuildSkip();
+        BOOST_CHECK(linked[i].HasAlgoLinks());
+        BOOST_CHECK(!unlinked[i].HasAlgoLinks());
+    }
+
+    for (int j = 0; j < 1000; j++) {
+        const size_t nHeight = InsecureRandRange(linked.size());
+        for (int algo = ALGO_UNKNOWN; algo < NUM_ALGOS_IMPL; algo++) {
+            const CBlockIndex* pindexLinked = GetLastBlockIndexForAlgo(&linked[nHeight], chainParams->GetConsensus(), algo);
+            const CBlockIndex* pindexUnlinked = GetLastBlockIndexForAlgo(&unlinked[nHeight], chainParams->GetConsensus(), algo);
+            BOOST_CHECK_EQUAL(pindexLinked ? pindexLinked->nHeight : -1, pindexUnlinked ? pindexUnlinked->nHeight : -1);
+        }
+    }
+}
+
+/* Test that the retarget context of the tip gives the same result as the V4 window walk */
+BOOST_AUTO_TEST_CASE(GetNextWorkRequiredV4_cached)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    Consensus::Params params = chainParams->GetConsensus();
+    params.workComputationChangeTarget = 0;
+    const int32_t algoVersions[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT, BLOCK_VERSION_ODO};
+    std::vector<uint256> hashes(600);
+    std::vector<CBlockIndex> blocks(600);
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+        hashes[i] = GetRandHash();
+        blocks[i].phashBlock = &hashes[i];
+        blocks[i].pprev = i ? &blocks[i - 1] : nullptr;
+        blocks[i].nHeight = i;
+        blocks[i].nVersion = BLOCK_VERSION_DEFAULT | algoVersions[InsecureRandRange(5)];
+        blocks[i].nTime = 1571000000 + i * params.nTargetSpacing + InsecureRandRange(60);
+        blocks[i].nBits = 0x1b000000 | (0x1000 + InsecureRandRange(0xf000));
+        blocks[i].BuildSkip();
+    }
+
+    for (int j = 0; j < 200; j++) {
+        const CBlockIndex* pindexLast = &blocks[InsecureRandRange(blocks.size())];
+        // computed on the spot, then from the context once it is the tip
+        for (int round = 0; round < 2; round++) {
+            for (int algo = 0; algo < NUM_ALGOS_IMPL; algo++) {
+                BOOST_CHECK_EQUAL(GetNextWorkRequiredV4Cached(pindexLast, params, algo), GetNextWorkRequiredV4(pindexLast, params, algo));
+            }
+            UpdateRetargetContext(pindexLast, params);
+        }
+    }
+
+    // The tip is answered from the context, which is only updated with the tip
+    CBlockIndex& tip = blocks.back();
+    UpdateRetargetContext(&tip, params);
+    const unsigned int nBefore = GetNextWorkRequiredV4Cached(&tip, params, ALGO_SHA256D);
+    tip.nTime += 3 * 60 * 60;
+    tip.nVersion = BLOCK_VERSION_DEFAULT | BLOCK_VERSION_SHA256D;
+    tip.nBits = 0x1c00ffff;
+    BOOST_CHECK(GetNextWorkRequiredV4(&tip, params, ALGO_SHA256D) != nBefore);
+    BOOST_CHECK_EQUAL(GetNextWorkRequiredV4Cached(&tip, params, ALGO_SHA256D), nBefore);
+
+    // A different block at the same address is not
+    hashes.back() = GetRandHash();
+    BOOST_CHECK_EQUAL(GetNextWorkRequiredV4Cached(&tip, params, ALGO_SHA256D), GetNextWorkRequiredV4(&tip, params, ALGO_SHA256D));
+    UpdateRetargetContext(nullptr, params);
+}
+
+/* Test that batched PoW hashing matches hashing each header on its own */
+BOOST_AUTO_TEST_CASE(GetPoWAlgoHashes_batch)
+{
+    const auto chainParams = CreateChainParams(CBaseChainParams::MAIN);
+    const int32_t algoVersions[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_GROESTL, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT, BLOCK_VERSION_ODO};
+    std::vector<CBlockHeader> headers(40);
+    std::vector<const CBlockHeader*> pheaders;
+    for (size_t i = 0; i < headers.size(); i++) {
+        // mostly scrypt, so that the multi-lane path sees full and partial batches
+        headers[i].nVersion = BLOCK_VERSION_DEFAULT | (i % 3 ? BLOCK_VERSION_SCRYPT : algoVersions[InsecureRandRange(6)]);
+        headers[i].hashPrevBlock = InsecureRand256();
+        headers[i].hashMerkleRoot = InsecureRand256();
+        headers[i].nTime = 1570060800 + i;
+        headers[i].nBits = 0x1e0fffff;
+        headers[i].nNonce = InsecureRand32();
+        pheaders.push_back(&headers[i]);
+    }
+
+    std::vector<uint256> hashes;
+    GetPoWAlgoHashes(pheaders, hashes, chainParams->GetConsensus());
+    BOOST_CHECK_EQUAL(hashes.size(), headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        BOOST_CHECK(hashes[i] == headers[i].GetPoWAlgoHash(chainParams->GetConsensus()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
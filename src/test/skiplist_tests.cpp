@@ -4,9 +4,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chain.h>
+#include <chainparams.h>
+#include <random.h>
 #include <util.h>
 #include <test/test_digibyte.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -178,4 +181,103 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(!chain.FindEarliestAtLeast(int64_t(std::numeric_limits<unsigned int>::max()) + 1));
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_arena_sort)
+{
+    // Two forks of a chain, with the entries created in random order across several chunks
+    const int nLength = 10000;
+    std::vector<int> vHeights;
+    for (int i = 0; i < nLength; i++) {
+        vHeights.push_back(i);
+        if (i >= nLength / 2) vHeights.push_back(i);
+    }
+    std::shuffle(vHeights.begin(), vHeights.end(), FastRandomContext());
+
+    CBlockIndexArena arena;
+    std::vector<CBlockIndex*> vMain(nLength, nullptr), vFork(nLength, nullptr);
+    for (int height : vHeights) {
+        CBlockIndex* pindex = arena.Allocate();
+        pindex->nHeight = height;
+        (vMain[height] == nullptr ? vMain : vFork)[height] = pindex;
+    }
+    for (int i = 1; i < nLength; i++) {
+        vMain[i]->pprev = vMain[i - 1];
+        if (vFork[i]) vFork[i]->pprev = vFork[i - 1] ? vFork[i - 1] : vMain[i - 1];
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), vHeights.size());
+
+    arena.SortByHeight([&](const CBlockIndexArena::Relocation& relocate) {
+        for (CBlockIndex*& pindex : vMain) pindex = relocate(pindex);
+        for (CBlockIndex*& pindex : vFork) pindex = relocate(pindex);
+    });
+
+    for (size_t i = 0; i < arena.Size(); i++) {
+        BOOST_CHECK(i == 0 || arena[i - 1].nHeight <= arena[i].nHeight);
+    }
+    for (int i = 0; i < nLength; i++) {
+        BOOST_CHECK_EQUAL(vMain[i]->nHeight, i);
+        BOOST_CHECK(vMain[i]->pprev == (i ? vMain[i - 1] : nullptr));
+        if (vFork[i]) {
+            BOOST_CHECK_EQUAL(vFork[i]->nHeight, i);
+            BOOST_CHECK(vFork[i]->pprev == (vFork[i - 1] ? vFork[i - 1] : vMain[i - 1]));
+        }
+    }
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+}
+
+BOOST_FIXTURE_TEST_CASE(blockindex_arena_chain_work, BasicTestingSetup)
+{
+    // A multi-algo chain past regtest's workComputationChangeTarget, with a
+    // fork, spread over more entries than one thread takes at a time
+    SelectParams(CBaseChainParams::REGTEST);
+    const Consensus::Params& params = Params().GetConsensus();
+    const int32_t algos[] = {BLOCK_VERSION_SHA256D, BLOCK_VERSION_SCRYPT, BLOCK_VERSION_GROESTL, BLOCK_VERSION_SKEIN, BLOCK_VERSION_QUBIT};
+    const int nLength = 1900;
+    const int nForkHeight = 1000;
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < nLength + (nLength - nForkHeight); i++) vHashes.push_back(GetRandHash());
+
+    CBlockIndexArena arena;
+    for (int i = 0; i < nLength; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        pindex->phashBlock = &vHashes[i];
+        pindex->pprev = i ? &arena[i - 1] : nullptr;
+        pindex->nHeight = i;
+        pindex->nVersion = BLOCK_VERSION_DEFAULT | algos[InsecureRandRange(5)];
+        pindex->nTime = 1389392876 + i * params.nPowTargetSpacing + InsecureRandRange(30);
+        pindex->nBits = UintToArith256(params.powLimit).GetCompact();
+        pindex->BuildSkip();
+    }
+    for (int i = nForkHeight; i < nLength; i++) {
+        CBlockIndex* pindex = arena.Allocate();
+        *pindex = arena[i];
+        pindex->phashBlock = &vHashes[arena.Size() - 1];
+        if (i > nForkHeight) pindex->pprev = &arena[arena.Size() - 2];
+        pindex->nVersion = BLOCK_VERSION_DEFAULT | algos[InsecureRandRange(5)];
+        pindex->nTime += InsecureRandRange(30);
+        pindex->BuildSkip();
+    }
+
+    std::vector<arith_uint256> vExpected;
+    for (size_t i = 0; i < arena.Size(); i++) {
+        arena[i].BuildChainWork();
+        vExpected.push_back(arena[i].nChainWork);
+    }
+    for (size_t i = 0; i < arena.Size(); i++) {
+        arena[i].nChainWork = arith_uint256();
+        arena[i].fHaveChainWork = false;
+    }
+
+    // Entries that have chain work are kept
+    arena[0].nChainWork = vExpected[0];
+    arena[0].fHaveChainWork = true;
+    arena.BuildChainWork(4);
+    for (size_t i = 0; i < arena.Size(); i++) {
+        BOOST_CHECK(arena[i].fHaveChainWork);
+        BOOST_CHECK(arena[i].nChainWork == vExpected[i]);
+    }
+    SelectParams(CBaseChainParams::MAIN);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
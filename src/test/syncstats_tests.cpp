@@ -0,0 +1,104 @@
+// Copyright (c) 2014-2019 The DigiByte Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <syncstats.h>
+#include <test/test_digibyte.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(syncstats_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(syncstats_percentiles)
+{
+    CSyncStats stats;
+    CSyncStageStats s = stats.Get(SyncStage::CONNECT_BLOCK);
+    BOOST_CHECK_EQUAL(s.nCount, 0U);
+    BOOST_CHECK_EQUAL(s.nWindow, 0U);
+    BOOST_CHECK_EQUAL(s.nMax, 0);
+
+    // Nearest rank of three durations, recorded out of order
+    stats.Record(SyncStage::CONNECT_BLOCK, 30);
+    stats.Record(SyncStage::CONNECT_BLOCK, 10);
+    stats.Record(SyncStage::CONNECT_BLOCK, 20, 5);
+    s = stats.Get(SyncStage::CONNECT_BLOCK);
+    BOOST_CHECK_EQUAL(s.nCount, 3U);
+    BOOST_CHECK_EQUAL(s.nTotal, 60);
+    BOOST_CHECK_EQUAL(s.nItems, 7U);
+    BOOST_CHECK_EQUAL(s.nWindow, 3U);
+    BOOST_CHECK_EQUAL(s.nMedian, 20);
+    BOOST_CHECK_EQUAL(s.nPercentile90, 30);
+    BOOST_CHECK_EQUAL(s.nPercentile99, 30);
+    BOOST_CHECK_EQUAL(s.nMax, 30);
+
+    // The stages are independent
+    BOOST_CHECK_EQUAL(stats.Get(SyncStage::PROCESS_HEADERS).nCount, 0U);
+
+    // 100 durations 1..100 in reverse order have every percentile as its own rank
+    for (int i = 100; i >= 1; i--)
+        stats.Record(SyncStage::PROCESS_HEADERS, i);
+    s = stats.Get(SyncStage::PROCESS_HEADERS);
+    BOOST_CHECK_EQUAL(s.nWindow, 100U);
+    BOOST_CHECK_EQUAL(s.nMedian, 50);
+    BOOST_CHECK_EQUAL(s.nPercentile90, 90);
+    BOOST_CHECK_EQUAL(s.nPercentile99, 99);
+    BOOST_CHECK_EQUAL(s.nMax, 100);
+}
+
+BOOST_AUTO_TEST_CASE(syncstats_window)
+{
+    CSyncStats stats;
+    const int64_t window = SYNC_STATS_WINDOW;
+
+    // Fill the window with 1..window
+    for (int64_t i = 1; i <= window; i++)
+        stats.Record(SyncStage::ACCEPT_BLOCK_HEADER, i);
+    CSyncStageStats s = stats.Get(SyncStage::ACCEPT_BLOCK_HEADER);
+    BOOST_CHECK_EQUAL(s.nWindow, SYNC_STATS_WINDOW);
+    BOOST_CHECK_EQUAL(s.nMedian, window / 2);
+    BOOST_CHECK_EQUAL(s.nMax, window);
+
+    // Ten more replace the ten oldest, while the totals keep counting
+    for (int64_t i = window + 1; i <= window + 10; i++)
+        stats.Record(SyncStage::ACCEPT_BLOCK_HEADER, i);
+    s = stats.Get(SyncStage::ACCEPT_BLOCK_HEADER);
+    BOOST_CHECK_EQUAL(s.nCount, SYNC_STATS_WINDOW + 10);
+    BOOST_CHECK_EQUAL(s.nTotal, (window + 10) * (window + 11) / 2);
+    BOOST_CHECK_EQUAL(s.nWindow, SYNC_STATS_WINDOW);
+    BOOST_CHECK_EQUAL(s.nMedian, window / 2 + 10);
+    BOOST_CHECK_EQUAL(s.nMax, window + 10);
+
+    // Wrapping around more than once leaves only the most recent window
+    for (int64_t i = 0; i < 2 * window + 5; i++)
+        stats.Record(SyncStage::ACCEPT_BLOCK_HEADER, 7);
+    s = stats.Get(SyncStage::ACCEPT_BLOCK_HEADER);
+    BOOST_CHECK_EQUAL(s.nWindow, SYNC_STATS_WINDOW);
+    BOOST_CHECK_EQUAL(s.nMedian, 7);
+    BOOST_CHECK_EQUAL(s.nMax, 7);
+}
+
+BOOST_AUTO_TEST_CASE(syncstats_get_and_reset)
+{
+    CSyncStats stats;
+    stats.Record(SyncStage::PROCESS_HEADERS, 40, 2000);
+    stats.Record(SyncStage::FIND_NEXT_BLOCKS, 3);
+
+    const std::vector<CSyncStageStats> all = stats.GetAndReset();
+    BOOST_REQUIRE_EQUAL(all.size(), (size_t)NUM_SYNC_STAGES);
+    BOOST_CHECK_EQUAL(all[static_cast<int>(SyncStage::PROCESS_HEADERS)].nItems, 2000U);
+    BOOST_CHECK_EQUAL(all[static_cast<int>(SyncStage::PROCESS_HEADERS)].nMax, 40);
+    BOOST_CHECK_EQUAL(all[static_cast<int>(SyncStage::FIND_NEXT_BLOCKS)].nMedian, 3);
+    BOOST_CHECK_EQUAL(all[static_cast<int>(SyncStage::CONNECT_BLOCK)].nCount, 0U);
+
+    for (int i = 0; i < NUM_SYNC_STAGES; i++) {
+        const CSyncStageStats s = stats.Get(static_cast<SyncStage>(i));
+        BOOST_CHECK_EQUAL(s.nCount, 0U);
+        BOOST_CHECK_EQUAL(s.nWindow, 0U);
+    }
+
+    // Recording continues from an empty window
+    stats.Record(SyncStage::PROCESS_HEADERS, 5);
+    BOOST_CHECK_EQUAL(stats.Get(SyncStage::PROCESS_HEADERS).nMax, 5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 #include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <crypto/hashqubit.h>
+#include <crypto/scrypt.h>
 #include <crypto/sha256.h>
 #include <validation.h>
 #include <miner.h>
@@ -14,6 +16,7 @@
 #include <pow.h>
 #include <ui_interface.h>
 #include <streams.h>
+#include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <script/sigcache.h>
@@ -49,6 +52,8 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     : m_path_root(fs::temp_directory_path() / "test_digibyte" / strprintf("%lu_%i", (unsigned long)GetTime(), (int)(InsecureRandRange(1 << 30))))
 {
     SHA256AutoDetect();
+    ScryptAutoDetect();
+    QubitAutoDetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
@@ -103,8 +108,12 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
             }
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadPowCheck);
+            threadGroup.create_thread(&ThreadCoinPrefetch);
+            threadGroup.create_thread(&ThreadUTXOScan);
+        }
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         peerLogic.reset(new PeerLogicValidation(connman, scheduler, /*enable_bip61=*/true));
@@ -4,12 +4,16 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <chain.h>
 #include <chainparams.h>
+#include <clientversion.h>
 #include <consensus/merkle.h>
 #include <consensus/validation.h>
 #include <miner.h>
 #include <pow.h>
 #include <random.h>
+#include <streams.h>
+#include <txdb.h>
 #include <test/test_digibyte.h>
 #include <validation.h>
 #include <validationinterface.h>
@@ -181,4 +185,162 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK_EQUAL(sub.m_expected_tip, chainActive.Tip()->GetBlockHash());
 }
 
+BOOST_AUTO_TEST_CASE(processnewblockheaders_bad_pow)
+{
+    std::vector<CBlockHeader> headers;
+    uint256 prev_hash = Params().GenesisBlock().GetHash();
+    for (int i = 0; i < 20; i++) {
+        headers.push_back(GoodBlock(prev_hash)->GetBlockHeader());
+        prev_hash = headers.back().GetHash();
+    }
+
+    // Break the proof of work of a header in the middle of the batch
+    std::vector<CBlockHeader> bad_headers(headers);
+    CBlockHeader& bad = bad_headers[12];
+    while (CheckProofOfWork(GetPoWAlgoHash(bad), bad.nBits, Params().GetConsensus())) {
+        ++bad.nNonce;
+    }
+
+    CValidationState state;
+    CBlockHeader first_invalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(bad_headers, state, Params(), nullptr, &first_invalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    BOOST_CHECK(first_invalid.GetHash() == bad.GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[11].GetHash()) != nullptr);
+        BOOST_CHECK(LookupBlockIndex(bad.GetHash()) == nullptr);
+    }
+
+    // A batch that does not connect is left to AcceptBlockHeader, which takes
+    // the headers up to the gap
+    std::vector<CBlockHeader> gap_headers(headers);
+    gap_headers.erase(gap_headers.begin() + 15);
+    CValidationState state_gap;
+    BOOST_CHECK(!ProcessNewBlockHeaders(gap_headers, state_gap, Params(), nullptr, &first_invalid));
+    BOOST_CHECK_EQUAL(state_gap.GetRejectReason(), "prev-blk-not-found");
+    BOOST_CHECK(first_invalid.GetHash() == headers[16].GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[14].GetHash()) != nullptr);
+        BOOST_CHECK(LookupBlockIndex(headers[16].GetHash()) == nullptr);
+    }
+
+    CValidationState state2;
+    const CBlockIndex* pindex = nullptr;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state2, Params(), &pindex));
+    BOOST_CHECK(pindex && pindex->GetBlockHash() == headers.back().GetHash());
+
+    // The index entries record that their proof of work was verified
+    LOCK(cs_main);
+    for (const CBlockHeader& header : headers) {
+        const CBlockIndex* pindex = LookupBlockIndex(header.GetHash());
+        BOOST_CHECK(pindex->nStatus & BLOCK_POW_CHECKED);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(diskblockindex_pow_checked)
+{
+    // No pprev, so the entry is serialized with a null hashPrev
+    CBlockHeader header = GoodBlock(Params().GenesisBlock().GetHash())->GetBlockHeader();
+    header.hashPrevBlock.SetNull();
+    CBlockIndex index(header);
+    index.nStatus = BLOCK_VALID_TREE;
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CDiskBlockIndex(&index);
+    const size_t unchecked_size = ss.size();
+    CDiskBlockIndex unchecked;
+    ss >> unchecked;
+    BOOST_CHECK(!(unchecked.nStatus & BLOCK_POW_CHECKED));
+
+    // The flag travels in nStatus, which at most grows its varint by a byte
+    index.nStatus |= BLOCK_POW_CHECKED;
+    ss << CDiskBlockIndex(&index);
+    BOOST_CHECK_EQUAL(ss.size(), unchecked_size + 1);
+    CDiskBlockIndex checked;
+    ss >> checked;
+    BOOST_CHECK(checked.nStatus & BLOCK_POW_CHECKED);
+    BOOST_CHECK(checked.GetBlockHash() == header.GetHash());
+}
+
+BOOST_FIXTURE_TEST_CASE(blockindex_snapshot, TestChain100Setup)
+{
+    LOCK(cs_main);
+    FlushStateToDisk();
+    const fs::path path = GetDataDir() / "blockindex.dat";
+    const size_t entries = mapBlockIndex.size();
+    const uint256 tip_hash = chainActive.Tip()->GetBlockHash();
+    const arith_uint256 tip_work = chainActive.Tip()->nChainWork;
+
+    // Load from an empty block tree database at the same generation, so only a
+    // snapshot can fill the index
+    std::unique_ptr<CBlockTreeDB> blocktree(new CBlockTreeDB(1 << 20, true));
+    while (blocktree->GetGeneration() < pblocktree->GetGeneration()) {
+        BOOST_REQUIRE(blocktree->WriteBatchSync({}, 0, {}));
+    }
+    std::swap(pblocktree, blocktree);
+
+    // Ignored, and discarded, unless enabled
+    BOOST_CHECK(DumpBlockIndexSnapshot());
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(mapBlockIndex.empty());
+    BOOST_CHECK(!fs::exists(path));
+
+    gArgs.ForceSetArg("-persistblockindex", "1");
+
+    // A damaged snapshot is discarded
+    std::swap(pblocktree, blocktree);
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(DumpBlockIndexSnapshot());
+    std::swap(pblocktree, blocktree);
+    {
+        FILE* file = fsbridge::fopen(path, "r+b");
+        BOOST_REQUIRE(file);
+        fseek(file, 100, SEEK_SET);
+        fputc(fgetc(file) ^ 1, file);
+        fclose(file);
+    }
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(mapBlockIndex.empty());
+    BOOST_CHECK(!fs::exists(path));
+
+    // An intact one restores the index, chain work included, and is used only once
+    std::swap(pblocktree, blocktree);
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(DumpBlockIndexSnapshot());
+    std::swap(pblocktree, blocktree);
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), entries);
+    BOOST_CHECK(!fs::exists(path));
+    const CBlockIndex* tip = LookupBlockIndex(tip_hash);
+    BOOST_REQUIRE(tip);
+    BOOST_CHECK(tip->nChainWork == tip_work);
+    BOOST_CHECK(pindexBestHeader == tip);
+
+    // One that predates a write to the block index database is discarded
+    std::swap(pblocktree, blocktree);
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(DumpBlockIndexSnapshot());
+    std::swap(pblocktree, blocktree);
+    BOOST_CHECK(pblocktree->WriteBatchSync({}, 0, {}));
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(mapBlockIndex.empty());
+    BOOST_CHECK(!fs::exists(path));
+
+    gArgs.ForceSetArg("-persistblockindex", "0");
+    std::swap(pblocktree, blocktree);
+    UnloadBlockIndex();
+    BOOST_CHECK(LoadBlockIndex(Params()));
+    BOOST_CHECK(LoadChainTip(Params()));
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == tip_hash);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,8 @@ static const char DB_HEAD_BLOCKS = 'H';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_UTXO_STATS = 'S';
+static const char DB_BLOCK_INDEX_GENERATION = 'G';
 
 namespace {
 
@@ -53,19 +55,51 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true),
+    m_pending_usage(0), m_pending_failed(false)
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    WaitForPendingWrite();
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    {
+        LOCK(cs_pending);
+        if (m_pending) {
+            CCoinsMap::const_iterator it = m_pending->find(outpoint);
+            if (it != m_pending->end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    // Not part of the background write, so the database is up to date for it
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    {
+        LOCK(cs_pending);
+        if (m_pending) {
+            CCoinsMap::const_iterator it = m_pending->find(outpoint);
+            if (it != m_pending->end())
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        LOCK(cs_pending);
+        if (m_pending)
+            return m_pending_block;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -81,6 +115,94 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    // Writes must reach the database in order
+    if (!WaitForPendingWrite())
+        return false;
+    CUTXOSetStats stats;
+    {
+        LOCK(cs_pending);
+        stats = m_next_stats;
+    }
+    bool ret = WriteCoins(mapCoins, hashBlock, stats);
+    mapCoins.clear();
+    return ret;
+}
+
+void CCoinsViewDB::BatchWriteAsync(CCoinsMap &&mapCoins, const uint256 &hashBlock) {
+    LOCK(cs_writer);
+    WaitForPendingWrite();
+    size_t nUsage = memusage::DynamicUsage(mapCoins);
+    for (const auto& entry : mapCoins)
+        nUsage += entry.second.coin.DynamicMemoryUsage();
+    std::shared_ptr<const CCoinsMap> pending = std::make_shared<const CCoinsMap>(std::move(mapCoins));
+    CUTXOSetStats stats;
+    {
+        LOCK(cs_pending);
+        if (m_pending_failed)
+            return;
+        m_pending = pending;
+        m_pending_block = hashBlock;
+        m_pending_usage = nUsage;
+        stats = m_next_stats;
+    }
+    m_writer = std::thread([this, pending, hashBlock, stats] {
+        RenameThread("digibyte-coinsflush");
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(*pending, hashBlock, stats);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        LOCK(cs_pending);
+        if (fOk) {
+            m_pending.reset();
+            m_pending_usage = 0;
+        } else {
+            // Keep answering reads from the entries, the node is going to shut down
+            m_pending_failed = true;
+        }
+    });
+}
+
+bool CCoinsViewDB::WaitForPendingWrite() const {
+    {
+        LOCK(cs_writer);
+        if (m_writer.joinable())
+            m_writer.join();
+    }
+    LOCK(cs_pending);
+    return !m_pending_failed;
+}
+
+bool CCoinsViewDB::HasPendingWrite() const {
+    LOCK(cs_pending);
+    return m_pending != nullptr;
+}
+
+bool CCoinsViewDB::PendingWriteFailed() const {
+    LOCK(cs_pending);
+    return m_pending_failed;
+}
+
+size_t CCoinsViewDB::PendingMemoryUsage() const {
+    LOCK(cs_pending);
+    return m_pending_usage;
+}
+
+void CCoinsViewDB::SetUTXOSetStats(const CUTXOSetStats &stats) {
+    LOCK(cs_pending);
+    m_next_stats = stats;
+}
+
+bool CCoinsViewDB::GetUTXOSetStats(CUTXOSetStats &stats) const {
+    if (!WaitForPendingWrite())
+        return false;
+    if (!db.Read(DB_UTXO_STATS, stats))
+        return false;
+    return stats.hashBlock == GetBestBlock();
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOSetStats &stats) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -88,7 +210,8 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip;
+    db.Read(DB_BEST_BLOCK, old_tip);
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -105,7 +228,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     batch.Erase(DB_BEST_BLOCK);
     batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
 
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             CoinEntry entry(&it->first);
             if (it->second.coin.IsSpent())
@@ -115,8 +238,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -134,6 +255,11 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     // In the last batch, mark the database as consistent with hashBlock again.
     batch.Erase(DB_HEAD_BLOCKS);
     batch.Write(DB_BEST_BLOCK, hashBlock);
+    // Only keep stats that match the new best block
+    if (stats.hashBlock == hashBlock)
+        batch.Write(DB_UTXO_STATS, stats);
+    else
+        batch.Erase(DB_UTXO_STATS);
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -146,7 +272,8 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe), nGeneration(0) {
+    Read(DB_BLOCK_INDEX_GENERATION, nGeneration);
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,22 +297,47 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
+    // Iterate over a database that is consistent with GetBestBlock
+    WaitForPendingWrite();
     CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
-    } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
-    }
+    i->CacheKey();
     return i;
 }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::Cursors(size_t nShards) const
+{
+    assert(nShards > 0 && nShards <= 0x10000);
+    WaitForPendingWrite();
+    const uint256 hashBestBlock = GetBestBlock();
+    std::vector<std::unique_ptr<CDBIterator>> iterators = const_cast<CDBWrapper&>(db).NewSnapshotIterators(nShards);
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    // Shard i starts at the txids whose first two bytes are 0x10000 * i / nShards
+    uint256 hashBegin;
+    for (size_t i = 0; i < nShards; i++) {
+        CCoinsViewDBCursor* cursor;
+        if (i + 1 < nShards) {
+            const size_t nEndPrefix = 0x10000 * (i + 1) / nShards;
+            uint256 hashEnd;
+            *hashEnd.begin() = nEndPrefix >> 8;
+            *(hashEnd.begin() + 1) = nEndPrefix & 0xff;
+            cursor = new CCoinsViewDBCursor(iterators[i].release(), hashBestBlock, hashEnd);
+            cursor->pcursor->Seek(std::make_pair(DB_COIN, hashBegin));
+            hashBegin = hashEnd;
+        } else {
+            cursor = new CCoinsViewDBCursor(iterators[i].release(), hashBestBlock);
+            cursor->pcursor->Seek(std::make_pair(DB_COIN, hashBegin));
+        }
+        cursor->CacheKey();
+        cursors.emplace_back(cursor);
+    }
+    return cursors;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -214,8 +366,13 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
+    CacheKey();
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
     CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || (fHaveEnd && keyTmp.second.hash.Compare(hashEnd) >= 0)) {
         keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
         keyTmp.first = entry.key;
@@ -231,7 +388,11 @@ bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockF
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
     }
-    return WriteBatch(batch, true);
+    batch.Write(DB_BLOCK_INDEX_GENERATION, nGeneration + 1);
+    if (!WriteBatch(batch, true))
+        return false;
+    nGeneration++;
+    return true;
 }
 
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
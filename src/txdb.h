@@ -8,13 +8,16 @@
 #define DIGIBYTE_TXDB_H
 
 #include <coins.h>
+#include <coinstats.h>
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -46,8 +49,22 @@ class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    //! Entries being written by m_writer, which reads are answered from until they are on disk
+    mutable CCriticalSection cs_pending;
+    std::shared_ptr<const CCoinsMap> m_pending GUARDED_BY(cs_pending);
+    uint256 m_pending_block GUARDED_BY(cs_pending);
+    size_t m_pending_usage GUARDED_BY(cs_pending);
+    bool m_pending_failed GUARDED_BY(cs_pending);
+    //! UTXO set stats to store with the next write, if they match its block
+    CUTXOSetStats m_next_stats GUARDED_BY(cs_pending);
+    mutable CCriticalSection cs_writer;
+    mutable std::thread m_writer GUARDED_BY(cs_writer);
+
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock, const CUTXOSetStats &stats);
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -56,6 +73,37 @@ public:
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * Split the coins into nShards parts of consecutive txids, and return a
+     * cursor over each. In order, the cursors visit the coins Cursor() would,
+     * and all of them read the same state of the database, so that they can be
+     * iterated in parallel. Outputs of one transaction are never split up.
+     */
+    std::vector<std::unique_ptr<CCoinsViewCursor>> Cursors(size_t nShards) const;
+
+    /**
+     * Write mapCoins on a background thread, after any previous background write. Until
+     * it is on disk, reads of its entries are answered from it, GetBestBlock returns
+     * hashBlock, and other writes and cursors wait for it.
+     */
+    void BatchWriteAsync(CCoinsMap &&mapCoins, const uint256 &hashBlock);
+    //! Wait for the background write, if any. Returns false if one failed.
+    bool WaitForPendingWrite() const;
+    //! Whether a background write is in progress, or failed. Does not wait.
+    bool HasPendingWrite() const;
+    //! Whether a background write failed. Does not wait.
+    bool PendingWriteFailed() const;
+    //! Memory held by the entries of the background write in progress.
+    size_t PendingMemoryUsage() const;
+
+    /**
+     * Stats of the UTXO set to store with the next write that moves the best
+     * block to stats.hashBlock. Any other write removes the stored stats.
+     */
+    void SetUTXOSetStats(const CUTXOSetStats &stats);
+    //! Read the stored UTXO set stats. Returns false if there are none for the best block.
+    bool GetUTXOSetStats(CUTXOSetStats &stats) const;
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
@@ -76,9 +124,16 @@ public:
 
 private:
     CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), fHaveEnd(false) {}
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn, const uint256 &hashEndIn):
+        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn), fHaveEnd(true), hashEnd(hashEndIn) {}
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! If set, the cursor ends before the first coin whose txid is not below hashEnd
+    bool fHaveEnd;
+    uint256 hashEnd;
+
+    void CacheKey();
 
     friend class CCoinsViewDB;
 };
@@ -86,6 +141,10 @@ private:
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
+private:
+    //! Number of WriteBatchSync calls over the lifetime of the database
+    uint64_t nGeneration;
+
 public:
     explicit CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -97,6 +156,8 @@ public:
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    //! Changes whenever block index entries or block file info are written, so that copies of them can tell whether they are current
+    uint64_t GetGeneration() const { return nGeneration; }
 };
 
 #endif // DIGIBYTE_TXDB_H
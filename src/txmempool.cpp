@@ -327,8 +327,8 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
     assert(int(nSigOpCostWithAncestors) >= 0);
 }
 
-CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator, const CTxMemPool* baseIn) :
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator), base(baseIn)
 {
     _clear(); //lock free clear
 
@@ -416,6 +416,8 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
 {
     NotifyEntryRemoved(it->GetSharedTx(), reason);
     const uint256 hash = it->GetTx().GetHash();
+    if (!base)
+        vTxidsRemoved.push_back(hash);
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
 
@@ -480,6 +482,8 @@ void CTxMemPool::removeRecursive(const CTransaction &origTx, MemPoolRemovalReaso
             // be sure to remove any children that are in the pool. This can
             // happen during chain re-orgs if origTx isn't re-accepted into
             // the mempool for any reason.
+            if (!base)
+                vTxidsRemoved.push_back(origTx.GetHash());
             for (unsigned int i = 0; i < origTx.vout.size(); i++) {
                 auto it = mapNextTx.find(COutPoint(origTx.GetHash(), i));
                 if (it == mapNextTx.end())
@@ -514,7 +518,7 @@ void CTxMemPool::removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMem
         } else if (it->GetSpendsCoinbase()) {
             for (const CTxIn& txin : tx.vin) {
                 indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
-                if (it2 != mapTx.end())
+                if (it2 != mapTx.end() || (base && base->exists(txin.prevout.hash)))
                     continue;
                 const Coin &coin = pcoins->AccessCoin(txin.prevout);
                 if (nCheckFrequency != 0) assert(!coin.IsSpent());
@@ -591,11 +595,56 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
     blockSinceLastRollingFeeBump = true;
 }
 
+void CTxMemPool::removeForBase(const CTransaction& tx)
+{
+    LOCK(cs);
+    txiter it = mapTx.find(tx.GetHash());
+    if (it != mapTx.end()) {
+        // As far as the overlay is concerned the transaction got confirmed:
+        // descendants stay, now spending an output found in the base pool.
+        setEntries stage;
+        stage.insert(it);
+        RemoveStaged(stage, true, MemPoolRemovalReason::BLOCK);
+    }
+    removeConflicts(tx);
+    ClearPrioritisation(tx.GetHash());
+}
+
+void CTxMemPool::removeOrphans(const CCoinsViewCache *pcoins, const std::vector<uint256>& vRemovedParents)
+{
+    // An overlay loses parents when its base pool drops them without them being mined
+    LOCK(cs);
+    setEntries txToRemove;
+    for (const uint256& hash : vRemovedParents) {
+        if (mapTx.count(hash) || (base && base->exists(hash)))
+            continue;
+        auto iter = mapNextTx.lower_bound(COutPoint(hash, 0));
+        for (; iter != mapNextTx.end() && iter->first->hash == hash; ++iter) {
+            if (!pcoins->HaveCoin(*iter->first))
+                txToRemove.insert(mapTx.find(iter->second->GetHash()));
+        }
+    }
+    setEntries setAllRemoves;
+    for (txiter it : txToRemove) {
+        CalculateDescendants(it, setAllRemoves);
+    }
+    RemoveStaged(setAllRemoves, false, MemPoolRemovalReason::CONFLICT);
+}
+
+std::vector<uint256> CTxMemPool::TakeRemovedTxids()
+{
+    LOCK(cs);
+    std::vector<uint256> vRemoved;
+    vRemoved.swap(vTxidsRemoved);
+    return vRemoved;
+}
+
 void CTxMemPool::_clear()
 {
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    vTxidsRemoved.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -633,7 +682,14 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
 
-    CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
+    // An overlay's transactions may spend outputs of transactions in its base pool
+    CCoinsView* pcoinsBase = const_cast<CCoinsViewCache*>(pcoins);
+    std::unique_ptr<CCoinsViewMemPool> viewBase;
+    if (base) {
+        viewBase.reset(new CCoinsViewMemPool(pcoinsBase, *base));
+        pcoinsBase = viewBase.get();
+    }
+    CCoinsViewCache mempoolDuplicate(pcoinsBase);
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
 
     std::list<const CTxMemPoolEntry*> waitingOnDependants;
@@ -662,7 +718,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
                     parentSigOpCost += it2->GetSigOpCost();
                 }
             } else {
-                assert(pcoins->HaveCoin(txin.prevout));
+                assert(pcoins->HaveCoin(txin.prevout) || (base && base->exists(txin.prevout.hash)));
             }
             // Check whether its inputs are marked in mapNextTx.
             auto it3 = mapNextTx.find(txin.prevout);
@@ -444,6 +444,8 @@ private:
     uint32_t nCheckFrequency GUARDED_BY(cs); //!< Value n means that n times in 2^32 we check.
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
     CBlockPolicyEstimator* minerPolicyEstimator;
+    const CTxMemPool* const base; //!< For an overlay, the pool that holds the parents it doesn't have itself
+    std::vector<uint256> vTxidsRemoved GUARDED_BY(cs); //!< For a pool without a base, the transactions removed since the last TakeRemovedTxids()
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
@@ -521,8 +523,13 @@ public:
     std::map<uint256, CAmount> mapDeltas;
 
     /** Create a new CTxMemPool.
+     *  An overlay (like the Dandelion stem pool) only holds its own transactions
+     *  and finds the unconfirmed parents they spend in its base pool.
      */
-    explicit CTxMemPool(CBlockPolicyEstimator* estimator = nullptr);
+    explicit CTxMemPool(CBlockPolicyEstimator* estimator = nullptr, const CTxMemPool* base = nullptr);
+
+    /** The pool under this overlay, or nullptr if this is not an overlay. */
+    const CTxMemPool* GetBase() const { return base; }
 
     /**
      * If sanity-checking is turned on, check makes sure the pool is
@@ -547,6 +554,15 @@ public:
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags);
     void removeConflicts(const CTransaction &tx) EXCLUSIVE_LOCKS_REQUIRED(cs);
     void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight);
+    /** Remove a transaction that made it into the base pool, and whatever conflicts with it, keeping its descendants. */
+    void removeForBase(const CTransaction& tx);
+    /**
+     * Remove transactions spending outputs of vRemovedParents, the txids the base pool dropped,
+     * that are found neither in this pool, its base pool nor pcoins, with their descendants.
+     */
+    void removeOrphans(const CCoinsViewCache *pcoins, const std::vector<uint256>& vRemovedParents);
+    /** Return and forget the txids removed from this pool, mined or not, for its overlay's removeOrphans(). */
+    std::vector<uint256> TakeRemovedTxids();
 
     void clear();
     void _clear() EXCLUSIVE_LOCKS_REQUIRED(cs); //lock free
@@ -10,13 +10,16 @@
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <checkqueue.h>
+#include <coinstats.h>
 #include <consensus/consensus.h>
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/sha256.h>
 #include <cuckoocache.h>
 #include <hash.h>
 #include <index/txindex.h>
+#include <memusage.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -29,6 +32,7 @@
 #include <script/sigcache.h>
 #include <script/standard.h>
 #include <shutdown.h>
+#include <syncstats.h>
 #include <timedata.h>
 #include <tinyformat.h>
 #include <txdb.h>
@@ -151,9 +155,16 @@ private:
      */
     CCriticalSection m_cs_chainstate;
 
+    /**
+     * The block after the one connected by the last ActivateBestChainStep, read ahead
+     * so that the coins it spends were warmed in the meantime. Used by the next step.
+     */
+    std::shared_ptr<const CBlock> m_block_read_ahead GUARDED_BY(cs_main);
+
 public:
     CChain chainActive;
     BlockMap mapBlockIndex;
+    CBlockIndexArena blockIndexArena;
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex *pindexBestInvalid = nullptr;
 
@@ -165,7 +176,7 @@ public:
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW = true) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
@@ -191,11 +202,13 @@ public:
 
 private:
     bool ActivateBestChainStep(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexMostWork, const std::shared_ptr<const CBlock>& pblock, bool& fInvalidFound, ConnectTrace& connectTrace);
-    bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool);
+    bool ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const CBlock>& pblockNext, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool);
 
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
     CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    /** Load the block index from a snapshot written at shutdown, if it matches the coins database tip. */
+    bool LoadBlockIndexSnapshot(const fs::path& path, const uint256& hashBestBlock, uint64_t nGeneration) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /**
      * Make various assertions about the state of the block index.
      *
@@ -216,6 +229,7 @@ private:
 CCriticalSection cs_main;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
+CBlockIndexArena& blockIndexArena = g_chainstate.blockIndexArena;
 CChain& chainActive = g_chainstate.chainActive;
 CBlockIndex *pindexBestHeader = nullptr;
 CWaitableCriticalSection g_best_block_mutex;
@@ -244,7 +258,7 @@ CAmount maxTxFee = DEFAULT_TRANSACTION_MAXFEE;
 CBlockPolicyEstimator feeEstimator;
 CTxMemPool mempool(&feeEstimator);
 std::atomic_bool g_is_mempool_loaded{false};
-CTxMemPool stempool(&feeEstimator);
+CTxMemPool stempool(nullptr, &mempool);
 
 /** Constant stuff for coinbase transactions we create: */
 CScript COINBASE_FLAGS;
@@ -299,6 +313,10 @@ std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
 
+/** Stats of the UTXO set as of pcoinsTip's best block, once LoadUTXOSetStats has run. */
+static CUTXOSetStats g_utxo_stats GUARDED_BY(cs_main);
+static bool g_utxo_stats_loaded GUARDED_BY(cs_main) = false;
+
 enum class FlushStateMode {
     NONE,
     IF_NEEDED,
@@ -500,8 +518,6 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool,
         // ignore validation errors in resurrected transactions
         CValidationState stateDummy;
         bool ret = !AcceptToMemoryPool(mempool, stateDummy, *it, nullptr, nullptr, true, 0);
-        CValidationState dandelionStateDummy;
-        AcceptToMemoryPool(stempool, dandelionStateDummy, *it, nullptr, nullptr, true, 0);
         if (!fAddToMempool || (*it)->IsCoinBase() || ret) {
             // If the transaction doesn't make it in to the mempool, remove any
             // transactions that depend on it (which would now be orphans).
@@ -520,8 +536,6 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool,
     // UpdateTransactionsFromBlock finds descendants of any transactions in
     // the disconnectpool that were added back and cleans up the mempool state.
     mempool.UpdateTransactionsFromBlock(vHashUpdate);
-    // Changes to mempool should also be made to Dandelion stempool
-    stempool.UpdateTransactionsFromBlock(vHashUpdate);
 
     // We also need to remove any now-immature transactions
     mempool.removeForReorg(pcoinsTip.get(), chainActive.Tip()->nHeight + 1, STANDARD_LOCKTIME_VERIFY_FLAGS);
@@ -531,6 +545,7 @@ static void UpdateMempoolForReorg(DisconnectedBlockTransactions &disconnectpool,
     LimitMempoolSize(mempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
     // Changes to mempool should also be made to Dandelion stempool
     LimitMempoolSize(stempool, gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+    stempool.removeOrphans(pcoinsTip.get(), mempool.TakeRemovedTxids());
 }
 
 // Used to avoid mempool polluting consensus critical paths if CCoinsViewMempool
@@ -554,7 +569,9 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
         // and then only have to check equivalence for available inputs.
         if (coin.IsSpent()) return false;
 
-        const CTransactionRef& txFrom = pool.get(txin.prevout.hash);
+        CTransactionRef txFrom = pool.get(txin.prevout.hash);
+        if (!txFrom && pool.GetBase())
+            txFrom = pool.GetBase()->get(txin.prevout.hash);
         if (txFrom) {
             assert(txFrom->GetHash() == txin.prevout.hash);
             assert(txFrom->vout.size() > txin.prevout.n);
@@ -606,10 +623,20 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         return state.DoS(0, false, REJECT_NONSTANDARD, "non-final");
 
     // is it already in the memory pool?
-    if (pool.exists(hash)) {
+    const CTxMemPool* base = pool.GetBase();
+    if (pool.exists(hash) || (base && base->exists(hash))) {
         return state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-mempool");
     }
 
+    // Transactions of an overlay pool may not replace anything in its base
+    if (base) {
+        LOCK(base->cs);
+        for (const CTxIn &txin : tx.vin) {
+            if (base->mapNextTx.count(txin.prevout))
+                return state.Invalid(false, REJECT_DUPLICATE, "txn-mempool-conflict");
+        }
+    }
+
     // Check for conflicts with in-memory transactions
     std::set<uint256> setConflicts;
     for (const CTxIn &txin : tx.vin)
@@ -658,7 +685,9 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         CCoinsViewCache view(&dummy);
 
         LockPoints lp;
-        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        // An overlay pool finds the unconfirmed parents it doesn't hold in its base
+        CCoinsViewMemPool viewBase(pcoinsTip.get(), base ? *base : pool);
+        CCoinsViewMemPool viewMemPool(base ? static_cast<CCoinsView*>(&viewBase) : pcoinsTip.get(), pool);
         view.SetBackend(viewMemPool);
 
         // do all inputs exist?
@@ -739,7 +768,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             return state.DoS(0, false, REJECT_NONSTANDARD, "bad-txns-too-many-sigops", false,
                 strprintf("%d", nSigOpsCost));
 
-        CAmount mempoolRejectFee = pool.GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+        CAmount mempoolRejectFee = (base ? *base : pool).GetMinFee(gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
         if (!bypass_limits && mempoolRejectFee > 0 && nModifiedFees < mempoolRejectFee) {
             return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool min fee not met", false, strprintf("%d < %d", nModifiedFees, mempoolRejectFee));
         }
@@ -996,6 +1025,11 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
     if (!res) {
         for (const COutPoint& hashTx : coins_to_uncache)
             pcoinsTip->Uncache(hashTx);
+    } else if (!test_accept && stempool.GetBase() == &pool) {
+        // Reaching the mempool ends the stem phase
+        stempool.removeForBase(*tx);
+        // Replacements and trimming may have taken out parents of stem transactions
+        stempool.removeOrphans(pcoinsTip.get(), pool.TakeRemovedTxids());
     }
     // After we've (potentially) uncached entries, ensure our coins cache is still within its size limits
     CValidationState stateDummy;
@@ -1085,7 +1119,7 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW)
 {
     block.SetNull();
 
@@ -1103,7 +1137,7 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     }
 
     // Check the header
-    if (!CheckProofOfWork(GetPoWAlgoHash(block), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckProofOfWork(GetPoWAlgoHash(block), block.nBits, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
@@ -1112,12 +1146,16 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     CDiskBlockPos blockPos;
+    bool fPoWChecked;
     {
         LOCK(cs_main);
         blockPos = pindex->GetBlockPos();
+        fPoWChecked = pindex->nStatus & BLOCK_POW_CHECKED;
     }
 
-    if (!ReadBlockFromDisk(block, blockPos, consensusParams))
+    // A header matching the index entry had its proof of work verified when
+    // the entry was created, so don't hash it again.
+    if (!ReadBlockFromDisk(block, blockPos, consensusParams, !fPoWChecked))
         return false;
     if (block.GetHash() != pindex->GetBlockHash())
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*): GetHash() doesn't match index for %s at %s",
@@ -1765,6 +1803,122 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/** Number of headers hashed by a single CPowCheck, a multiple of the widest scrypt implementation */
+static const size_t POW_CHECK_HEADERS = 8;
+
+/**
+ * Closure representing the proof-of-work check of a few headers of a HEADERS
+ * message. Marks each header that passes in the shared result vector.
+ */
+class CPowCheck
+{
+private:
+    const std::vector<CBlockHeader>* m_headers;
+    std::vector<size_t> m_indexes;
+    std::vector<char>* m_checked;
+    std::atomic<bool>* m_failed;
+    const Consensus::Params* m_params;
+
+public:
+    CPowCheck(): m_headers(nullptr), m_checked(nullptr), m_failed(nullptr), m_params(nullptr) {}
+    CPowCheck(const std::vector<CBlockHeader>* headers, std::vector<size_t>&& indexes, std::vector<char>* checked, std::atomic<bool>* failed, const Consensus::Params& params) :
+        m_headers(headers), m_indexes(std::move(indexes)), m_checked(checked), m_failed(failed), m_params(&params) {}
+
+    bool operator()()
+    {
+        // Headers after a failed one are not accepted anyway
+        if (m_failed->load(std::memory_order_relaxed))
+            return false;
+        std::vector<const CBlockHeader*> vHeaders;
+        for (size_t i : m_indexes)
+            vHeaders.push_back(&(*m_headers)[i]);
+        std::vector<uint256> vHashes;
+        GetPoWAlgoHashes(vHeaders, vHashes, *m_params);
+        for (size_t n = 0; n < m_indexes.size(); n++) {
+            if (!CheckProofOfWork(vHashes[n], vHeaders[n]->nBits, *m_params)) {
+                m_failed->store(true, std::memory_order_relaxed);
+                return false;
+            }
+            (*m_checked)[m_indexes[n]] = 1;
+        }
+        return true;
+    }
+
+    void swap(CPowCheck& check)
+    {
+        std::swap(m_headers, check.m_headers);
+        m_indexes.swap(check.m_indexes);
+        std::swap(m_checked, check.m_checked);
+        std::swap(m_failed, check.m_failed);
+        std::swap(m_params, check.m_params);
+    }
+};
+
+static CCheckQueue<CPowCheck> powcheckqueue(4);
+
+void ThreadPowCheck() {
+    RenameThread("digibyte-powch");
+    powcheckqueue.Thread();
+}
+
+/** Number of outpoints looked up by a single CCoinPrefetch */
+static const size_t COIN_PREFETCH_OUTPOINTS = 16;
+
+/**
+ * Closure representing the database lookups of a few coins spent by a block
+ * that is about to be connected. Stores each coin that is found in the shared
+ * result vector, at the index of its outpoint.
+ *
+ * Lookups for the block after that one own their outpoints instead, and drop
+ * the coins: they only warm the database caches, and nothing waits for them.
+ */
+class CCoinPrefetch
+{
+private:
+    const std::vector<COutPoint>* m_outpoints;
+    size_t m_begin;
+    size_t m_end;
+    std::vector<Coin>* m_coins;
+    std::vector<COutPoint> m_warm;
+
+public:
+    CCoinPrefetch(): m_outpoints(nullptr), m_begin(0), m_end(0), m_coins(nullptr) {}
+    CCoinPrefetch(const std::vector<COutPoint>* outpoints, size_t begin, size_t end, std::vector<Coin>* coins) :
+        m_outpoints(outpoints), m_begin(begin), m_end(end), m_coins(coins) {}
+    explicit CCoinPrefetch(std::vector<COutPoint>&& warm) : m_outpoints(nullptr), m_begin(0), m_end(0), m_coins(nullptr), m_warm(std::move(warm)) {}
+
+    bool operator()()
+    {
+        // Only a head start for ConnectBlock, which repeats any lookup that
+        // fails here and handles database errors itself.
+        try {
+            for (size_t i = m_begin; i < m_end; i++)
+                pcoinsdbview->GetCoin((*m_outpoints)[i], (*m_coins)[i]);
+            Coin coin;
+            for (const COutPoint& outpoint : m_warm)
+                pcoinsdbview->GetCoin(outpoint, coin);
+        } catch (const std::exception&) {
+        }
+        return true;
+    }
+
+    void swap(CCoinPrefetch& check)
+    {
+        std::swap(m_outpoints, check.m_outpoints);
+        std::swap(m_begin, check.m_begin);
+        std::swap(m_end, check.m_end);
+        std::swap(m_coins, check.m_coins);
+        m_warm.swap(check.m_warm);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> prefetchqueue(4);
+
+void ThreadCoinPrefetch() {
+    RenameThread("digibyte-prefetch");
+    prefetchqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1782,15 +1936,25 @@ int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Para
     return nVersion;
 }
 
+bool IsOdoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus)
+{
+    return pindexPrev && pindexPrev->nHeight >= consensus.multiAlgoDiffChangeTarget && pindexPrev->nHeight >= consensus.algoSwapChangeTarget &&
+        VersionBitsState(pindexPrev, consensus, Consensus::DEPLOYMENT_ODO, versionbitscache) == ThresholdState::ACTIVE;
+}
+
 bool IsAlgoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus, int algo)
+{
+    return IsAlgoActive(pindexPrev, consensus, algo, IsOdoActive(pindexPrev, consensus));
+}
+
+bool IsAlgoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus, int algo, bool fOdoActive)
 {
     if (!pindexPrev)
         return algo == ALGO_SCRYPT;
     const int nHeight = pindexPrev->nHeight;
     if (nHeight < consensus.multiAlgoDiffChangeTarget)
         return algo == ALGO_SCRYPT;
-    else if (nHeight < consensus.algoSwapChangeTarget ||
-             VersionBitsState(pindexPrev, consensus, Consensus::DEPLOYMENT_ODO, versionbitscache) != ThresholdState::ACTIVE)
+    else if (!fOdoActive)
     {
         return algo == ALGO_SHA256D
             || algo == ALGO_SCRYPT
@@ -1925,7 +2089,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     // is enforced in ContextualCheckBlockHeader(); we wouldn't want to
     // re-enforce that rule here (at least until we make it impossible for
     // GetAdjustedTime() to go backward).
-    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck, !fJustCheck)) {
+    // The PoW of the header was verified when it was added to the block index; only
+    // entries written by older versions lack BLOCK_POW_CHECKED and need to be checked again.
+    if (!CheckBlock(block, state, chainparams.GetConsensus(), !fJustCheck && !(pindex->nStatus & BLOCK_POW_CHECKED), !fJustCheck)) {
         if (state.CorruptionPossible()) {
             // We don't write down blocks to disk if they may have been
             // corrupted, so this should be impossible unless we're having hardware
@@ -2194,20 +2360,27 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
  * or always and in all cases if we're in prune mode and are deleting files.
  *
  * If FlushStateMode::NONE is used, then FlushStateToDisk(...) won't do anything
- * besides checking if we need to prune.
+ * besides checking if we need to prune, and whether a background write of the
+ * coins finished or failed since the last call.
  */
 bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight) {
     int64_t nMempoolUsage = mempool.DynamicMemoryUsage();
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
     static int64_t nLastFlush = 0;
+    // Chain state that is being flushed in the background, to notify about once it is on disk
+    static CBlockLocator locatorPendingFlush;
     std::set<int> setFilesToPrune;
     bool full_flush_completed = false;
+    CBlockLocator locatorFlushed;
     try {
     {
         bool fFlushForPrune = false;
         bool fDoFullFlush = false;
         LOCK(cs_LastBlockFile);
+        // Do not keep connecting blocks on top of a chain state that did not make it to disk
+        if (pcoinsdbview->PendingWriteFailed())
+            return AbortNode(state, "Failed to write to coin database");
         if (fPruneMode && (fCheckForPruning || nManualPruneHeight > 0) && !fReindex) {
             if (nManualPruneHeight > 0) {
                 FindFilesToPruneManual(setFilesToPrune, nManualPruneHeight);
@@ -2232,7 +2405,8 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastFlush = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
-        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // Coins still being written in the background count against the cache, so that we wait for them rather than pile up more
+        int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() + pcoinsdbview->PendingMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
         bool fCacheLarge = mode == FlushStateMode::PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -2283,16 +2457,37 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Writes to the coin database happen in order, so wait for any background one first.
+            if (!pcoinsdbview->WaitForPendingWrite())
                 return AbortNode(state, "Failed to write to coin database");
+            if (g_utxo_stats_loaded)
+                pcoinsdbview->SetUTXOSetStats(g_utxo_stats);
+            if (mode == FlushStateMode::ALWAYS || fFlushForPrune) {
+                // Flush the chainstate (which may refer to block index entries).
+                if (!pcoinsTip->Flush())
+                    return AbortNode(state, "Failed to write to coin database");
+                full_flush_completed = true;
+                locatorPendingFlush.SetNull();
+            } else {
+                // Write the modified coins while blocks keep connecting. Together with
+                // the recently created coins that stay cached, they take half the space,
+                // leaving the other half for the blocks connected in the meantime.
+                pcoinsdbview->BatchWriteAsync(pcoinsTip->TakeDirtyEntries(nTotalSpace / 2), pcoinsTip->GetBestBlock());
+                locatorPendingFlush = chainActive.GetLocator();
+            }
             nLastFlush = nNow;
-            full_flush_completed = true;
+        }
+        if (!locatorPendingFlush.IsNull() && !pcoinsdbview->HasPendingWrite()) {
+            locatorFlushed = locatorPendingFlush;
+            locatorPendingFlush.SetNull();
         }
     }
     if (full_flush_completed) {
         // Update best block in wallet (so we can detect restored wallets).
         GetMainSignals().ChainStateFlushed(chainActive.GetLocator());
+    } else if (!locatorFlushed.IsNull()) {
+        // A background flush has finished since the last call
+        GetMainSignals().ChainStateFlushed(locatorFlushed);
     }
     } catch (const std::runtime_error& e) {
         return AbortNode(state, std::string("System error while flushing: ") + e.what());
@@ -2429,6 +2624,8 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
         assert(view.GetBestBlock() == pindexDelete->GetBlockHash());
         if (DisconnectBlock(block, pindexDelete, view) != DISCONNECT_OK)
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+        if (g_utxo_stats_loaded)
+            g_utxo_stats.ApplyBlock(block, pindexDelete->nHeight, GetBlockSpentCoins(block, view), false);
         bool flushed = view.Flush();
         assert(flushed);
     }
@@ -2453,6 +2650,7 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     }
 
     chainActive.SetTip(pindexDelete->pprev);
+    UpdateRetargetContext(pindexDelete->pprev, chainparams.GetConsensus());
 
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
@@ -2462,6 +2660,10 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
+static int64_t nTimeWarm = 0;
+static int64_t nTimeReadAhead = 0;
+static int64_t nTimeUTXOStats = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2532,13 +2734,82 @@ public:
     }
 };
 
+/** The coins spent by a block that are neither in pcoinsTip nor created by the block itself. */
+static std::vector<COutPoint> GetUncachedBlockInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    // Skip coins created by the block itself; they are not in the database yet.
+    std::set<uint256> setBlockTxids;
+    for (const auto& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (tx->IsCoinBase())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (!setBlockTxids.count(txin.prevout.hash) && !pcoinsTip->HaveCoinInCache(txin.prevout))
+                vOutpoints.push_back(txin.prevout);
+        }
+    }
+    return vOutpoints;
+}
+
+/**
+ * Look up the coins spent by a block that are not in pcoinsTip yet, spread
+ * over the prefetch threads, and add them to pcoinsTip. ConnectBlock then finds
+ * them in the cache instead of reading them from the database one at a time.
+ */
+static void PrefetchBlockInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    std::vector<COutPoint> vOutpoints = GetUncachedBlockInputs(block);
+    if (vOutpoints.size() < 2)
+        return;
+
+    std::vector<Coin> vCoins(vOutpoints.size());
+    std::vector<CCoinPrefetch> vChecks;
+    for (size_t i = 0; i < vOutpoints.size(); i += COIN_PREFETCH_OUTPOINTS)
+        vChecks.emplace_back(&vOutpoints, i, std::min(i + COIN_PREFETCH_OUTPOINTS, vOutpoints.size()), &vCoins);
+    {
+        CCheckQueueControl<CCoinPrefetch> control(&prefetchqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        if (!vCoins[i].IsSpent())
+            pcoinsTip->AddFetchedCoin(vOutpoints[i], std::move(vCoins[i]));
+    }
+}
+
+/**
+ * Queue the database lookups of the coins spent by the block that is connected
+ * after the current one, without waiting for them. The prefetch threads run
+ * them while the current block is connected, so that its own prefetch later
+ * finds them in the database caches. A prefetch waits for any that are left.
+ */
+static void WarmBlockInputs(const CBlock& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    std::vector<COutPoint> vOutpoints = GetUncachedBlockInputs(block);
+    std::vector<CCoinPrefetch> vChecks;
+    for (size_t i = 0; i < vOutpoints.size(); i += COIN_PREFETCH_OUTPOINTS) {
+        const auto end = vOutpoints.begin() + std::min(i + COIN_PREFETCH_OUTPOINTS, vOutpoints.size());
+        vChecks.emplace_back(std::vector<COutPoint>(vOutpoints.begin() + i, end));
+    }
+    prefetchqueue.Add(vChecks);
+}
+
 /**
  * Connect a new block to chainActive. pblock is either nullptr or a pointer to a CBlock
- * corresponding to pindexNew, to bypass loading it again from disk.
+ * corresponding to pindexNew, to bypass loading it again from disk. pblockNext is either
+ * nullptr or the block to be connected after it, whose inputs are warmed meanwhile.
  *
  * The block is added to connectTrace if connection succeeds.
  */
-bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool)
+bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainparams, CBlockIndex* pindexNew, const std::shared_ptr<const CBlock>& pblock, const std::shared_ptr<const CBlock>& pblockNext, ConnectTrace& connectTrace, DisconnectedBlockTransactions &disconnectpool)
 {
     assert(pindexNew->pprev == chainActive.Tip());
     // Read block from disk.
@@ -2557,6 +2828,19 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    PrefetchBlockInputs(blockConnecting);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
+    nTime2 = nTimePrefetched;
+    if (pblockNext) {
+        WarmBlockInputs(*pblockNext);
+        int64_t nTimeWarmed = GetTimeMicros(); nTimeWarm += nTimeWarmed - nTime2;
+        LogPrint(BCLog::BENCH, "  - Queue next block inputs: %.2fms [%.2fs]\n", (nTimeWarmed - nTime2) * MILLI, nTimeWarm * MICRO);
+        nTime2 = nTimeWarmed;
+    }
+    std::vector<std::pair<COutPoint, Coin>> vSpent;
+    if (g_utxo_stats_loaded)
+        vSpent = GetBlockSpentCoins(blockConnecting, *pcoinsTip);
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2567,12 +2851,23 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
             return error("ConnectTip(): ConnectBlock %s failed", pindexNew->GetBlockHash().ToString());
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
+        g_sync_stats.Record(SyncStage::CONNECT_BLOCK, nTime3 - nTime2);
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
         bool flushed = view.Flush();
         assert(flushed);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
+    if (g_utxo_stats_loaded) {
+        // The outputs of the genesis block are not part of the set
+        if (pindexNew->pprev)
+            g_utxo_stats.ApplyBlock(blockConnecting, pindexNew->nHeight, vSpent, true);
+        else
+            g_utxo_stats.hashBlock = pindexNew->GetBlockHash();
+        int64_t nTimeStats = GetTimeMicros(); nTimeUTXOStats += nTimeStats - nTime4;
+        LogPrint(BCLog::BENCH, "  - UTXO set stats: %.2fms [%.2fs (%.2fms/blk)]\n", (nTimeStats - nTime4) * MILLI, nTimeUTXOStats * MICRO, nTimeUTXOStats * MILLI / nBlocksTotal);
+        nTime4 = nTimeStats;
+    }
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FlushStateMode::IF_NEEDED))
         return false;
@@ -2582,9 +2877,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
     // Changes to mempool should also be made to Dandelion stempool
     stempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+    stempool.removeOrphans(pcoinsTip.get(), mempool.TakeRemovedTxids());
     disconnectpool.removeForBlock(blockConnecting.vtx);
     // Update chainActive & related variables.
     chainActive.SetTip(pindexNew);
+    UpdateRetargetContext(pindexNew, chainparams.GetConsensus());
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
@@ -2708,7 +3005,31 @@ bool CChainState::ActivateBestChainStep(CValidationState& state, const CChainPar
 
         // Connect new blocks.
         for (CBlockIndex *pindexConnect : reverse_iterate(vpindexToConnect)) {
-            if (!ConnectTip(state, chainparams, pindexConnect, pindexConnect == pindexMostWork ? pblock : std::shared_ptr<const CBlock>(), connectTrace, disconnectpool)) {
+            std::shared_ptr<const CBlock> pblockConnect;
+            if (pindexConnect == pindexMostWork) {
+                pblockConnect = pblock;
+            } else if (m_block_read_ahead && m_block_read_ahead->GetHash() == pindexConnect->GetBlockHash()) {
+                pblockConnect = m_block_read_ahead;
+            }
+            // Read the next block before connecting this one, so that the coins it
+            // spends can be warmed on the prefetch threads in the meantime.
+            m_block_read_ahead.reset();
+            std::shared_ptr<const CBlock> pblockNext;
+            if (pindexConnect != pindexMostWork && nScriptCheckThreads) {
+                int64_t nTimeStart = GetTimeMicros();
+                const CBlockIndex* pindexNext = pindexMostWork->GetAncestor(pindexConnect->nHeight + 1);
+                if (pindexNext == pindexMostWork && pblock) {
+                    pblockNext = pblock;
+                } else if (pindexNext->nStatus & BLOCK_HAVE_DATA) {
+                    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+                    // On failure ConnectTip reads it again and reports the error
+                    if (ReadBlockFromDisk(*pblockRead, pindexNext, chainparams.GetConsensus()))
+                        m_block_read_ahead = pblockNext = pblockRead;
+                }
+                int64_t nTimeRead = GetTimeMicros(); nTimeReadAhead += nTimeRead - nTimeStart;
+                LogPrint(BCLog::BENCH, "  - Read ahead next block: %.2fms [%.2fs]\n", (nTimeRead - nTimeStart) * MILLI, nTimeReadAhead * MICRO);
+            }
+            if (!ConnectTip(state, chainparams, pindexConnect, pblockConnect, pblockNext, connectTrace, disconnectpool)) {
                 if (state.IsInvalid()) {
                     // The block violates a consensus rule.
                     if (!state.CorruptionPossible()) {
@@ -3036,7 +3357,7 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
+    CBlockIndex* pindexNew = blockIndexArena.Allocate(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3048,10 +3369,10 @@ CBlockIndex* CChainState::AddToBlockIndex(const CBlockHeader& block)
     {
         pindexNew->pprev = (*miPrev).second;
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
-        pindexNew->BuildSkip();
     }
+    pindexNew->BuildSkip();
     pindexNew->nTimeMax = (pindexNew->pprev ? std::max(pindexNew->pprev->nTimeMax, pindexNew->nTime) : pindexNew->nTime);
-    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
+    pindexNew->BuildChainWork();
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == nullptr || pindexBestHeader->nChainWork < pindexNew->nChainWork)
         pindexBestHeader = pindexNew;
@@ -3464,8 +3785,9 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex, bool fCheckPOW)
 {
+    CSyncStageTimer timer(SyncStage::ACCEPT_BLOCK_HEADER);
     AssertLockHeld(cs_main);
     // Check for duplicate
     uint256 hash = block.GetHash();
@@ -3482,7 +3804,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state, chainparams.GetConsensus()))
+        if (!CheckBlockHeader(block, state, chainparams.GetConsensus(), fCheckPOW))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3514,8 +3836,12 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             }
         }
     }
-    if (pindex == nullptr)
+    if (pindex == nullptr) {
         pindex = AddToBlockIndex(block);
+        // Only the genesis block is added without its PoW being checked
+        if (hash != chainparams.GetConsensus().hashGenesisBlock)
+            pindex->nStatus |= BLOCK_POW_CHECKED;
+    }
 
     if (ppindex)
         *ppindex = pindex;
@@ -3525,15 +3851,73 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/**
+ * Verify the proof of work of the headers in a HEADERS message that are not yet
+ * in mapBlockIndex, spreading them over the PoW check threads. Returns a flag per
+ * header that is set if its PoW was verified; unset headers (already known, failed,
+ * or skipped after a failure) are left to CheckBlockHeader as usual.
+ */
+static std::vector<char> CheckHeadersProofOfWork(const std::vector<CBlockHeader>& headers, const Consensus::Params& params)
+{
+    std::vector<char> vPowChecked(headers.size(), 0);
+    // Only headers that connect are worth hashing up front; AcceptBlockHeader
+    // rejects the others before it gets to their proof of work.
+    std::vector<uint256> vHashes(headers.size());
+    for (size_t i = 0; i < headers.size(); i++) {
+        vHashes[i] = headers[i].GetHash();
+        if (i > 0 && headers[i].hashPrevBlock != vHashes[i - 1])
+            return vPowChecked;
+    }
+    std::vector<size_t> vUnknown;
+    {
+        LOCK(cs_main);
+        if (headers.empty() || LookupBlockIndex(headers[0].hashPrevBlock) == nullptr)
+            return vPowChecked;
+        for (size_t i = 0; i < headers.size(); i++) {
+            if (LookupBlockIndex(vHashes[i]) == nullptr)
+                vUnknown.push_back(i);
+        }
+    }
+    // A single header (e.g. a new block announcement) gains nothing from this.
+    if (vUnknown.size() < 2)
+        return vPowChecked;
+
+    // Once a check fails, the ones not started yet return right away
+    std::atomic<bool> fFailed(false);
+    std::vector<CPowCheck> vChecks;
+    for (size_t i = 0; i < vUnknown.size(); i += POW_CHECK_HEADERS) {
+        std::vector<size_t> vIndexes(vUnknown.begin() + i, vUnknown.begin() + std::min(i + POW_CHECK_HEADERS, vUnknown.size()));
+        vChecks.emplace_back(&headers, std::move(vIndexes), &vPowChecked, &fFailed, params);
+    }
+    if (nScriptCheckThreads) {
+        // The queue hands out the checks added last first, so add the earliest
+        // headers last: a failure then cuts off the work on the headers after it.
+        std::reverse(vChecks.begin(), vChecks.end());
+        CCheckQueueControl<CPowCheck> control(&powcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        for (CPowCheck& check : vChecks) {
+            if (!check())
+                break;
+        }
+    }
+    return vPowChecked;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+    // Hashing is far more expensive than the contextual checks for most algos,
+    // so do it up front without holding cs_main.
+    const std::vector<char> vPowChecked = CheckHeadersProofOfWork(headers, chainparams.GetConsensus());
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, chainparams, &pindex, !vPowChecked[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3928,33 +4312,214 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    CBlockIndex* pindexNew = blockIndexArena.Allocate();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+static const uint32_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
+//! Message start, version, coins tip, block index database generation and entry count
+static const size_t BLOCK_INDEX_SNAPSHOT_HEADER_SIZE = 4 + 4 + 32 + 8 + 8;
+//! Block hash, previous hash, merkle root and chain work, followed by ten 32 bit fields
+static const size_t BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE = 4 * 32 + 10 * 4;
+
+static fs::path GetBlockIndexSnapshotPath()
+{
+    return GetDataDir() / "blockindex.dat";
+}
+
+namespace {
+
+/** Read-only view of a whole file, memory mapped where the platform allows it. */
+class CMappedFile
+{
+public:
+    explicit CMappedFile(const fs::path& path)
+    {
+#ifndef WIN32
+        int fd = open(path.string().c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size > 0) {
+            void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, size, MADV_SEQUENTIAL);
+                m_data = static_cast<const unsigned char*>(addr);
+                m_size = size;
+            }
+        }
+        close(fd);
+#else
+        FILE* file = fsbridge::fopen(path, "rb");
+        if (!file)
+            return;
+        unsigned char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+            m_buffer.insert(m_buffer.end(), buf, buf + n);
+        fclose(file);
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+#endif
+    }
+
+    ~CMappedFile()
+    {
+#ifndef WIN32
+        if (m_data)
+            munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+    }
+
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef WIN32
+    std::vector<unsigned char> m_buffer;
+#endif
+};
+
+void WriteBlockIndexSnapshotEntry(unsigned char* p, const CBlockIndex& index)
+{
+    const uint256 hashPrev = index.pprev ? index.pprev->GetBlockHash() : uint256();
+    const uint256 nChainWork = ArithToUint256(index.nChainWork);
+    memcpy(p, index.GetBlockHash().begin(), 32);
+    memcpy(p + 32, hashPrev.begin(), 32);
+    memcpy(p + 64, index.hashMerkleRoot.begin(), 32);
+    memcpy(p + 96, nChainWork.begin(), 32);
+    WriteLE32(p + 128, index.nHeight);
+    WriteLE32(p + 132, index.nFile);
+    WriteLE32(p + 136, index.nDataPos);
+    WriteLE32(p + 140, index.nUndoPos);
+    WriteLE32(p + 144, index.nVersion);
+    WriteLE32(p + 148, index.nTime);
+    WriteLE32(p + 152, index.nBits);
+    WriteLE32(p + 156, index.nNonce);
+    WriteLE32(p + 160, index.nStatus);
+    WriteLE32(p + 164, index.nTx);
+}
+
+uint256 ReadSnapshotHash(const unsigned char* p)
+{
+    uint256 hash;
+    memcpy(hash.begin(), p, 32);
+    return hash;
+}
+
+} // namespace
+
+bool CChainState::LoadBlockIndexSnapshot(const fs::path& path, const uint256& hashBestBlock, uint64_t nGeneration)
+{
+    AssertLockHeld(cs_main);
+
+    CMappedFile file(path);
+    const unsigned char* p = file.data();
+    if (!p || file.size() < BLOCK_INDEX_SNAPSHOT_HEADER_SIZE + CSHA256::OUTPUT_SIZE)
+        return error("%s: unable to read %s", __func__, path.string());
+
+    if (memcmp(p, Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE) != 0 || ReadLE32(p + 4) != BLOCK_INDEX_SNAPSHOT_VERSION)
+        return error("%s: unknown snapshot format", __func__);
+    // Any write to the block index database since the snapshot was taken, be it
+    // of headers only, moves its generation on.
+    if (ReadSnapshotHash(p + 8) != hashBestBlock || ReadLE64(p + 40) != nGeneration) {
+        LogPrintf("%s: snapshot was taken at %s (block index generation %u), databases are at %s (generation %u)\n", __func__,
+            ReadSnapshotHash(p + 8).ToString(), ReadLE64(p + 40), hashBestBlock.ToString(), nGeneration);
+        return false;
+    }
+    const uint64_t nEntries = ReadLE64(p + 48);
+    const size_t nBody = file.size() - BLOCK_INDEX_SNAPSHOT_HEADER_SIZE - CSHA256::OUTPUT_SIZE;
+    if (nEntries == 0 || nBody / BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE != nEntries || nBody % BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE != 0)
+        return error("%s: snapshot size mismatch", __func__);
+
+    unsigned char checksum[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(p, file.size() - CSHA256::OUTPUT_SIZE).Finalize(checksum);
+    if (memcmp(checksum, p + file.size() - CSHA256::OUTPUT_SIZE, CSHA256::OUTPUT_SIZE) != 0)
+        return error("%s: snapshot checksum mismatch", __func__);
+
+    mapBlockIndex.reserve(nEntries);
+    p += BLOCK_INDEX_SNAPSHOT_HEADER_SIZE;
+    for (uint64_t i = 0; i < nEntries; i++, p += BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE) {
+        CBlockIndex* pindexNew = InsertBlockIndex(ReadSnapshotHash(p));
+        pindexNew->pprev          = InsertBlockIndex(ReadSnapshotHash(p + 32));
+        pindexNew->hashMerkleRoot = ReadSnapshotHash(p + 64);
+        pindexNew->nChainWork     = UintToArith256(ReadSnapshotHash(p + 96));
+        pindexNew->nHeight        = ReadLE32(p + 128);
+        pindexNew->nFile          = ReadLE32(p + 132);
+        pindexNew->nDataPos       = ReadLE32(p + 136);
+        pindexNew->nUndoPos       = ReadLE32(p + 140);
+        pindexNew->nVersion       = ReadLE32(p + 144);
+        pindexNew->nTime          = ReadLE32(p + 148);
+        pindexNew->nBits          = ReadLE32(p + 152);
+        pindexNew->nNonce         = ReadLE32(p + 156);
+        pindexNew->nStatus        = ReadLE32(p + 160);
+        pindexNew->nTx            = ReadLE32(p + 164);
+        // fHaveChainWork stays unset: GetBlockProof only derives proofs from
+        // chain work computed in this process, not from what was read back.
+    }
+
+    LogPrintf("%s: loaded %u entries from %s\n", __func__, nEntries, path.string());
+    return true;
+}
+
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    // A snapshot is only good for the startup following the shutdown that
+    // wrote it; the block index database moves on from here.
+    bool fSnapshotLoaded = false;
+    const fs::path snapshot_path = GetBlockIndexSnapshotPath();
+    if (fs::exists(snapshot_path)) {
+        if (gArgs.GetBoolArg("-persistblockindex", DEFAULT_PERSIST_BLOCK_INDEX) && !fReindex && !gArgs.GetBoolArg("-reindex-chainstate", false) && pcoinsdbview) {
+            fSnapshotLoaded = LoadBlockIndexSnapshot(snapshot_path, pcoinsdbview->GetBestBlock(), blocktree.GetGeneration());
+            if (!fSnapshotLoaded) {
+                // Nothing was inserted unless the whole snapshot checked out.
+                assert(mapBlockIndex.empty());
+            }
+        }
+        fs::remove(snapshot_path);
+    }
+
+    if (!fSnapshotLoaded && !blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
         return false;
 
     boost::this_thread::interruption_point();
 
-    // Calculate nChainWork
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
-    {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+    // The entries were created in key order; lay them out by height so that
+    // they can be walked in order below, and stay close to their ancestors.
+    blockIndexArena.SortByHeight([this](const CBlockIndexArena::Relocation& relocate) {
+        for (BlockMap::value_type& entry : mapBlockIndex) {
+            entry.second = relocate(entry.second);
+        }
+    });
+    assert(blockIndexArena.Size() == mapBlockIndex.size());
+
+    // Link the skip and per-algo pointers first; retargeting walks them when
+    // computing the block proofs.
+    for (size_t i = 0; i < blockIndexArena.Size(); i++) {
+        blockIndexArena[i].BuildSkip();
+    }
+
+    // Calculate nChainWork, unless it came with the snapshot
+    if (!fSnapshotLoaded) {
+        const int64_t nTimeChainWork = GetTimeMicros();
+        const int nThreads = std::max(nScriptCheckThreads, 1);
+        blockIndexArena.BuildChainWork(nThreads);
+        LogPrint(BCLog::BENCH, "%s: chain work in %.2fms using %d threads\n", __func__, (GetTimeMicros() - nTimeChainWork) * MILLI, nThreads);
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
+
+    boost::this_thread::interruption_point();
+
+    for (size_t i = 0; i < blockIndexArena.Size(); i++)
     {
-        CBlockIndex* pindex = item.second;
-        pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+        CBlockIndex* pindex = &blockIndexArena[i];
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
@@ -3978,12 +4543,14 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
             pindexBestInvalid = pindex;
-        if (pindex->pprev)
-            pindex->BuildSkip();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == nullptr || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
 
+    LogPrintf("%s: %u entries, %.1f MiB (arena %.1f MiB)\n", __func__, mapBlockIndex.size(),
+        (blockIndexArena.DynamicMemoryUsage() + memusage::DynamicUsage(mapBlockIndex)) * (1.0 / (1 << 20)),
+        blockIndexArena.DynamicMemoryUsage() * (1.0 / (1 << 20)));
+
     return true;
 }
 
@@ -4063,6 +4630,7 @@ bool LoadChainTip(const CChainParams& chainparams)
         return false;
     }
     chainActive.SetTip(pindex);
+    UpdateRetargetContext(pindex, chainparams.GetConsensus());
 
     g_chainstate.PruneBlockIndexCandidates();
 
@@ -4073,6 +4641,32 @@ bool LoadChainTip(const CChainParams& chainparams)
     return true;
 }
 
+bool LoadUTXOSetStats()
+{
+    LOCK(cs_main);
+    g_utxo_stats_loaded = false;
+    if (!pcoinsdbview->GetUTXOSetStats(g_utxo_stats)) {
+        LogPrintf("Computing UTXO set stats...\n");
+        int64_t nStart = GetTimeMillis();
+        if (!ComputeUTXOSetStats(*pcoinsdbview, g_utxo_stats, std::max(nScriptCheckThreads, 1)))
+            return error("%s: failed to read the UTXO set", __func__);
+        LogPrintf(" UTXO set stats computed in %dms\n", GetTimeMillis() - nStart);
+    }
+    if (g_utxo_stats.hashBlock != pcoinsTip->GetBestBlock())
+        return error("%s: UTXO set stats are for block %s, not %s", __func__, g_utxo_stats.hashBlock.ToString(), pcoinsTip->GetBestBlock().ToString());
+    g_utxo_stats_loaded = true;
+    return true;
+}
+
+bool GetUTXOSetStats(CUTXOSetStats& stats)
+{
+    LOCK(cs_main);
+    if (!g_utxo_stats_loaded)
+        return false;
+    stats = g_utxo_stats;
+    return true;
+}
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0, false);
@@ -4122,7 +4716,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
             return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
         // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus()))
+        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus(), !(pindex->nStatus & BLOCK_POW_CHECKED)))
             return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
                          pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
         // check level 2: verify undo validity
@@ -4379,6 +4973,7 @@ bool RewindBlockIndex(const CChainParams& params) {
 
 void CChainState::UnloadBlockIndex() {
     nBlockSequenceId = 1;
+    m_block_read_ahead.reset();
     m_failed_blocks.clear();
     setBlockIndexCandidates.clear();
 }
@@ -4390,6 +4985,8 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     chainActive.SetTip(nullptr);
+    UpdateRetargetContext(nullptr, Params().GetConsensus());
+    g_utxo_stats_loaded = false;
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
     mempool.clear();
@@ -4405,10 +5002,8 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 
     g_chainstate.UnloadBlockIndex();
@@ -4840,21 +5435,13 @@ bool LoadMempool(void)
             CAmount amountdelta = nFeeDelta;
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
-                // Changes to mempool should also be made to Dandelion stempool
-                stempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
             CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
                 LOCK(cs_main);
-                int64_t nTimeCopy = nTime; // time isn't const, need copy for Dandelion
                 AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
                                            nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
                                            false /* test_accept */);
-                // Changes to mempool should also be made to Dandelion stempool
-                CValidationState dummyState;
-                AcceptToMemoryPoolWithTime(chainparams, stempool, dummyState, tx, nullptr /* pfMissingInputs */, nTimeCopy,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */,
-                                           false /* test_accept */);
                 if (state.IsValid()) {
                     ++count;
                 } else {
@@ -4879,8 +5466,6 @@ bool LoadMempool(void)
 
         for (const auto& i : mapDeltas) {
             mempool.PrioritiseTransaction(i.first, i.second);
-            // Changes to mempool should also be made to Dandelion stempool
-            stempool.PrioritiseTransaction(i.first, i.second);
         }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
@@ -4941,6 +5526,67 @@ bool DumpMempool(void)
     return true;
 }
 
+bool DumpBlockIndexSnapshot()
+{
+    int64_t start = GetTimeMicros();
+
+    LOCK(cs_main);
+    // Only a block index that has been fully written to the database can
+    // stand in for it.
+    if (!pcoinsdbview || !pblocktree || !setDirtyBlockIndex.empty() || mapBlockIndex.empty())
+        return false;
+
+    const fs::path snapshot_path = GetBlockIndexSnapshotPath();
+    const fs::path snapshot_path_new = snapshot_path.string() + ".new";
+    try {
+        FILE* filestr = fsbridge::fopen(snapshot_path_new, "wb");
+        if (!filestr) {
+            return false;
+        }
+
+        CAutoFile file(filestr, SER_DISK, CLIENT_VERSION);
+        CSHA256 hasher;
+
+        unsigned char header[BLOCK_INDEX_SNAPSHOT_HEADER_SIZE];
+        memcpy(header, Params().MessageStart(), CMessageHeader::MESSAGE_START_SIZE);
+        WriteLE32(header + 4, BLOCK_INDEX_SNAPSHOT_VERSION);
+        const uint256 hashBestBlock = pcoinsdbview->GetBestBlock();
+        memcpy(header + 8, hashBestBlock.begin(), 32);
+        WriteLE64(header + 40, pblocktree->GetGeneration());
+        WriteLE64(header + 48, mapBlockIndex.size());
+        file.write((const char*)header, sizeof(header));
+        hasher.Write(header, sizeof(header));
+
+        // The arena keeps every entry after its parent, which is what the
+        // loader needs to link them up in a single pass.
+        std::vector<unsigned char> buf;
+        buf.reserve(BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE * 4096);
+        for (size_t i = 0; i < blockIndexArena.Size(); i++) {
+            buf.resize(buf.size() + BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE);
+            WriteBlockIndexSnapshotEntry(buf.data() + buf.size() - BLOCK_INDEX_SNAPSHOT_ENTRY_SIZE, blockIndexArena[i]);
+            if (buf.size() == buf.capacity() || i + 1 == blockIndexArena.Size()) {
+                file.write((const char*)buf.data(), buf.size());
+                hasher.Write(buf.data(), buf.size());
+                buf.clear();
+            }
+        }
+
+        unsigned char checksum[CSHA256::OUTPUT_SIZE];
+        hasher.Finalize(checksum);
+        file.write((const char*)checksum, sizeof(checksum));
+
+        if (!FileCommit(file.Get()))
+            throw std::runtime_error("FileCommit failed");
+        file.fclose();
+        RenameOver(snapshot_path_new, snapshot_path);
+        LogPrintf("Dumped block index: %u entries in %gs\n", mapBlockIndex.size(), (GetTimeMicros() - start) * MICRO);
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to dump block index: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 //! require cs_main if pindex has not been validated yet (because nChainTx might be unset)
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
@@ -4959,16 +5605,3 @@ double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pin
 
     return pindex->nChainTx / fTxTotal;
 }
-
-class CMainCleanup
-{
-public:
-    CMainCleanup() {}
-    ~CMainCleanup() {
-        // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
-        mapBlockIndex.clear();
-    }
-} instance_of_cmaincleanup;
@@ -42,6 +42,7 @@
 #define SECONDS_PER_MONTH (SECONDS * MINUTES * HOURS * DAYS_PER_YEAR / MONTHS_PER_YEAR);
 
 class CBlockIndex;
+class CBlockIndexArena;
 class CBlockTreeDB;
 class CChainParams;
 class CCoinsViewDB;
@@ -52,6 +53,7 @@ class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
 struct ChainTxData;
+struct CUTXOSetStats;
 
 struct PrecomputedTransactionData;
 struct LockPoints;
@@ -97,10 +99,21 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
+/** Number of blocks that can be requested at any given time from a single peer whose download rate has not
+ *  been measured yet. Measured peers get as many as cover their round trip and BLOCK_DOWNLOAD_TARGET_LATENCY. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 32;
-/** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
+/** Upper bound on the number of blocks in flight from a single peer, however fast it delivers them. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE = 1024;
+/** Time (in microseconds) worth of a peer's measured block download rate to keep in flight on top of its round trip. */
+static const int64_t BLOCK_DOWNLOAD_TARGET_LATENCY = 1000000;
+/** Number of blocks a peer's download rate must be averaged over before it is used. */
+static const int BLOCK_DOWNLOAD_MIN_SAMPLES = 8;
+/** Fastest download rate (in bytes per second) a single block is taken to arrive at, 1 Gbit/s. */
+static const int64_t MAX_BLOCK_DOWNLOAD_RATE = 125 * 1000 * 1000;
+/** Timeout in seconds during which a peer must stall block download progress before being disconnected. Peers with
+ *  a measured download rate get twice the time needed to deliver their blocks in flight, up to BLOCK_STALLING_TIMEOUT_MAX. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
+static const unsigned int BLOCK_STALLING_TIMEOUT_MAX = 16;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 10000;
@@ -111,9 +124,12 @@ static const int MAX_CMPCTBLOCK_DEPTH = 5;
 static const int MAX_BLOCKTXN_DEPTH = 10;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
- *  degree of disordering of blocks on disk (which make reindexing and pruning harder). We'll probably
- *  want to make this a per-peer adaptive value at some point. */
+ *  degree of disordering of blocks on disk (which make reindexing and pruning harder). The window spans
+ *  BLOCK_DOWNLOAD_WINDOW_BYTES of blocks of the recent average size, between BLOCK_DOWNLOAD_WINDOW and
+ *  MAX_BLOCK_DOWNLOAD_WINDOW blocks, so that chains of small, fast blocks are not held to 1024 of them. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+static const unsigned int MAX_BLOCK_DOWNLOAD_WINDOW = 16384;
+static const int64_t BLOCK_DOWNLOAD_WINDOW_BYTES = 64 * 1000 * 1000;
 /** Time to wait (in seconds) between writing blocks/block index to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
@@ -133,9 +149,13 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+/** Default for -utxosetcommitment */
+static const bool DEFAULT_UTXO_SET_COMMITMENT = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Default for -persistblockindex */
+static const bool DEFAULT_PERSIST_BLOCK_INDEX = false;
 /** Default for -mempoolreplacement */
 static const bool DEFAULT_ENABLE_REPLACEMENT = true;
 /** Default for using fee filter */
@@ -165,6 +185,8 @@ extern std::atomic_bool g_is_mempool_loaded;
 extern CTxMemPool stempool;
 typedef std::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap& mapBlockIndex;
+/** Storage of the entries in mapBlockIndex. */
+extern CBlockIndexArena& blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockWeight;
 extern const std::string strMessageMagic;
@@ -275,10 +297,18 @@ bool LoadGenesisBlock(const CChainParams& chainparams);
 bool LoadBlockIndex(const CChainParams& chainparams) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Update the chain tip based on database information. */
 bool LoadChainTip(const CChainParams& chainparams);
+/** Load the rolling UTXO set stats, recomputing them if none were stored for the coins tip */
+bool LoadUTXOSetStats();
+/** Get the stats of the UTXO set as of the coins tip; false unless LoadUTXOSetStats succeeded, which needs -utxosetcommitment */
+bool GetUTXOSetStats(CUTXOSetStats& stats);
 /** Unload database information */
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadPowCheck();
+/** Run an instance of the thread that prefetches the coins spent by blocks being connected */
+void ThreadCoinPrefetch();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -412,7 +442,7 @@ void InitScriptExecutionCache();
 
 
 /** Functions for disk access for blocks */
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams, bool fCheckPOW = true);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
 bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
@@ -501,6 +531,10 @@ extern VersionBitsCache versionbitscache;
 int32_t ComputeBlockVersion(const CBlockIndex* pindexPrev, const Consensus::Params& params, int algo);
 
 bool IsAlgoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus, int algo);
+/** IsAlgoActive with the Odo deployment state for pindexPrev already looked up by IsOdoActive. Does not use the version bits cache. */
+bool IsAlgoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus, int algo, bool fOdoActive);
+/** Whether the algo swap to Odo is in effect for the block after pindexPrev. */
+bool IsOdoActive(const CBlockIndex* pindexPrev, const Consensus::Params& consensus);
 
 /** Reject codes greater or equal to this can be returned by AcceptToMemPool
  * for transactions, to signal internal conditions. They cannot and should not
@@ -522,6 +556,9 @@ bool DumpMempool();
 /** Load the mempool from disk. */
 bool LoadMempool();
 
+/** Dump the block index, including chain work, to disk so the next startup can skip rebuilding it. */
+bool DumpBlockIndexSnapshot();
+
 /** Compute at which vout of the block's coinbase transaction the witness commitment occurs, or -1 if not found */
 inline int GetWitnessCommitmentIndex(const CBlock& block)
 {
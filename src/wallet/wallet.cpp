@@ -4440,10 +4440,6 @@ bool CWalletTx::AcceptToMemoryPool(const CAmount& nAbsurdFee, CValidationState&
     } else {
         ret = ::AcceptToMemoryPool(mempool, state, tx, nullptr /* pfMissingInputs */,
                                    nullptr /* plTxnReplaced */, false /* bypass_limits */, nAbsurdFee);
-        // Changes to mempool should also be made to Dandelion stempool
-        CValidationState dummyState;
-        ret = ::AcceptToMemoryPool(stempool, dummyState, tx, nullptr /* pfMissingInputs */,
-                                   nullptr /* plTxnReplaced */, false /* bypass_limits */, nAbsurdFee);
     }
     fInMempool |= ret;
     return ret;